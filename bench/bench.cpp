@@ -0,0 +1,510 @@
+/* bench.cpp
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "src/chordgraph.h"
+#include "src/transitionnetwork.h"
+#include "src/realizationgraph.h"
+#include "src/voicingcache.h"
+#include "src/transpositioncache.h"
+#include "src/voicingeditor.h"
+#include "src/corpus.h"
+#include <iostream>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <string.h>
+#include <stdlib.h>
+
+struct bench_case {
+    std::string name;
+    std::function<void()> run;
+};
+
+struct bench_result {
+    std::string name;
+    int reps;
+    double min, median, mean, max;
+};
+
+static void show_usage(std::string name) {
+    std::cerr << "Usage: " << name << " [<option(s)>]\n"
+              << "Options:\n"
+              << " -h, --help               Show this help message\n"
+              << " -r, --repetitions        Specify the number of timed repetitions per benchmark (default: 5)\n"
+              << " -f, --filter             Run only benchmarks whose names contain the given string\n"
+              << " -s, --sequences          Specify directory with chord sequences (default: sequences)\n"
+              << " -o, --output-format      Specify output format, either 'table', 'csv', or 'json' (default: table)\n"
+              << " -l, --list               List benchmark names and exit"
+              << std::endl;
+}
+
+static bool read_sequence(const std::string &filename, std::vector<Chord> &seq) {
+    Corpus corpus;
+    if (!corpus.open(filename.c_str()) || corpus.size() == 0)
+        return false;
+    return corpus.sequence(0, seq);
+}
+
+static std::vector<std::string> list_sequences(const std::string &dirname) {
+    std::vector<std::string> files;
+    DIR *dir = opendir(dirname.c_str());
+    if (dir == NULL)
+        return files;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        std::string name = ent->d_name;
+        if (name.size() > 4 && name.substr(name.size() - 4) == ".seq")
+            files.push_back(name);
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+/* returns the walk in cg of length at most len which consists of the chords in seqs, in order, skipping those
+ * which cannot follow the preceding chord */
+static std::vector<Chord> chain(const ChordGraph &cg, const std::vector<std::vector<Chord> > &seqs, int len) {
+    std::vector<Chord> ret;
+    int u = 0, v;
+    for (std::vector<std::vector<Chord> >::const_iterator it = seqs.begin(); it != seqs.end(); ++it) {
+        for (std::vector<Chord>::const_iterator jt = it->begin(); jt != it->end() && int(ret.size()) < len; ++jt) {
+            v = cg.find_vertex_by_chord(*jt);
+            if (v != 0 && (u == 0 || cg.arc(u, v) != NULL)) {
+                ret.push_back(*jt);
+                u = v;
+            }
+        }
+    }
+    return ret;
+}
+
+/* returns the first chord in chords which may replace the i-th chord in the walk seq in cg, other than itself */
+static Chord replacement(const ChordGraph &cg, const std::vector<Chord> &seq, int i, const std::vector<Chord> &chords) {
+    int n = seq.size(), v;
+    for (std::vector<Chord>::const_iterator it = chords.begin(); it != chords.end(); ++it) {
+        v = cg.find_vertex_by_chord(*it);
+        if (*it != seq[i] && v != 0 && (i == 0 || cg.arc(cg.find_vertex_by_chord(seq[i-1]), v) != NULL) &&
+                (i + 1 == n || cg.arc(v, cg.find_vertex_by_chord(seq[i+1])) != NULL))
+            return *it;
+    }
+    return seq[i];
+}
+
+static bench_result measure(const bench_case &bc, int reps) {
+    std::vector<double> t;
+    bc.run(); // warm-up
+    for (int i = 0; i < reps; ++i) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bc.run();
+        std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+        t.push_back(d.count());
+    }
+    std::sort(t.begin(), t.end());
+    bench_result res;
+    res.name = bc.name;
+    res.reps = reps;
+    res.min = t.front();
+    res.max = t.back();
+    res.median = reps % 2 ? t[reps / 2] : (t[reps / 2 - 1] + t[reps / 2]) / 2.0;
+    res.mean = 0;
+    for (std::vector<double>::const_iterator it = t.begin(); it != t.end(); ++it) {
+        res.mean += *it;
+    }
+    res.mean /= reps;
+    return res;
+}
+
+static void output_result(const bench_result &res, const std::string &format, bool first) {
+    if (format == "csv") {
+        if (first)
+            std::cout << "name,repetitions,min,median,mean,max\n";
+        std::cout << res.name << "," << res.reps << "," << res.min << "," << res.median << ","
+                  << res.mean << "," << res.max << std::endl;
+    } else if (format == "json") {
+        std::cout << (first ? "[\n" : ",\n")
+                  << "  {\"name\": \"" << res.name << "\", \"repetitions\": " << res.reps
+                  << ", \"min\": " << res.min << ", \"median\": " << res.median
+                  << ", \"mean\": " << res.mean << ", \"max\": " << res.max << "}";
+    } else {
+        if (first) {
+            std::cout.width(60);
+            std::cout << std::left << "benchmark" << "\treps\tmedian [s]\tmin [s]\t\tmax [s]\n";
+        }
+        std::cout.width(60);
+        std::cout << std::left << res.name << "\t" << res.reps << "\t" << res.median << "\t"
+                  << res.min << "\t" << res.max << std::endl;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int reps = 5;
+    bool list_only = false;
+    std::string filter = "", seq_dir = "sequences", format = "table";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            show_usage(argv[0]);
+            return 0;
+        } else if ((arg == "-r" || arg == "--repetitions") && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+            if (reps <= 0) {
+                std::cerr << "Error: invalid number of repetitions, expected a positive integer" << std::endl;
+                return 1;
+            }
+        } else if ((arg == "-f" || arg == "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if ((arg == "-s" || arg == "--sequences") && i + 1 < argc) {
+            seq_dir = argv[++i];
+        } else if ((arg == "-o" || arg == "--output-format") && i + 1 < argc) {
+            format = argv[++i];
+            if (format != "table" && format != "csv" && format != "json") {
+                std::cerr << "Error: invalid output format, expected either 'table', 'csv', or 'json'" << std::endl;
+                return 1;
+            }
+        } else if (arg == "-l" || arg == "--list") {
+            list_only = true;
+        } else {
+            std::cerr << "Error: invalid option '" << arg << "'" << std::endl;
+            return 1;
+        }
+    }
+    std::vector<Chord> all_chords = Chord::all_seventh_chords();
+    std::vector<Chord> dom7 = Chord::dominant_seventh_chords();
+    Domain dom = Domain::usual();
+    std::vector<bench_case> cases;
+    bench_case bc;
+    /* realizations and transitions */
+    bc.name = "Realization::tonal_realizations";
+    bc.run = [&]() {
+        for (std::vector<Chord>::const_iterator it = all_chords.begin(); it != all_chords.end(); ++it) {
+            Realization::tonal_realizations(*it, dom, true);
+        }
+    };
+    cases.push_back(bc);
+    bc.name = "Transition::elementary_transitions";
+    bc.run = [&]() {
+        for (std::vector<Chord>::const_iterator it = dom7.begin(); it != dom7.end(); ++it) {
+            for (std::vector<Chord>::const_iterator jt = all_chords.begin(); jt != all_chords.end(); ++jt) {
+                if (*it != *jt)
+                    Transition::elementary_transitions(*it, *jt, 7, dom, NO_PREPARATION, true);
+            }
+        }
+    };
+    cases.push_back(bc);
+    bc.name = "Transition::elementary_classes";
+    bc.run = [&]() {
+        for (std::vector<Chord>::const_iterator it = dom7.begin(); it != dom7.end(); ++it) {
+            for (std::vector<Chord>::const_iterator jt = dom7.begin(); jt != dom7.end(); ++jt) {
+                if (it != jt)
+                    Transition::elementary_classes(*it, *jt, 7, NO_PREPARATION, 0, true);
+            }
+        }
+    };
+    cases.push_back(bc);
+    bc.name = "Transition::elementary_types";
+    bc.run = [&]() {
+        Transition::elementary_types(dom7, 7, NO_PREPARATION, 0, true, true, true);
+    };
+    cases.push_back(bc);
+    /* chord graphs */
+    bc.name = "ChordGraph::ChordGraph";
+    bc.run = [&]() {
+        ChordGraph cg(all_chords, 7, dom, NO_PREPARATION, true, false, 0);
+    };
+    cases.push_back(bc);
+    bc.name = "ChordGraph::ChordGraph (-vc)";
+    bc.run = [&]() {
+        ChordGraph cg(all_chords, 7, dom, NO_PREPARATION, true, false, 1);
+    };
+    cases.push_back(bc);
+    /* voicings (the chord graph and the realization graph are shared by all sequences and built only once) */
+    ChordGraph *cg = NULL;
+    RealizationGraph *rg = NULL;
+    TranspositionCache *tc = NULL;
+    bc.name = "RealizationGraph::RealizationGraph";
+    bc.run = [&cg]() {
+        RealizationGraph g(*cg);
+    };
+    cases.push_back(bc);
+    bc.name = "TranspositionCache::TranspositionCache";
+    bc.run = [&cg]() {
+        TranspositionCache cache(*cg);
+    };
+    cases.push_back(bc);
+    std::vector<std::string> seq_files = list_sequences(seq_dir);
+    std::vector<std::vector<Chord> > seqs;
+    for (std::vector<std::string>::const_iterator it = seq_files.begin(); it != seq_files.end(); ++it) {
+        std::vector<Chord> seq;
+        if (!read_sequence(seq_dir + "/" + *it, seq)) {
+            std::cerr << "Warning: failed to read sequence from '" << *it << "'" << std::endl;
+            continue;
+        }
+        seqs.push_back(seq);
+        std::string name = it->substr(0, it->size() - 4);
+        bc.name = "TransitionNetwork::find_voicing " + name;
+        bc.run = [&cg,seq]() {
+            voicing v;
+            int z0;
+            cg->find_voicing(seq, z0, 1.0, 1.75, 1.4, v);
+        };
+        cases.push_back(bc);
+        bc.name = "RealizationGraph::find_voicing " + name;
+        bc.run = [&rg,seq]() {
+            voicing v;
+            int z0;
+            rg->find_voicing(seq, z0, 1.0, 1.75, 1.4, v);
+        };
+        cases.push_back(bc);
+        bc.name = "TransitionNetwork::find_all_optimal_voicings " + name;
+        bc.run = [&cg,seq]() {
+            std::set<voicing> vs;
+            cg->find_voicings(seq, 1.0, 1.75, 1.4, vs);
+        };
+        cases.push_back(bc);
+        bc.name = "TransitionNetwork::find_best_voicings " + name;
+        bc.run = [&cg,seq]() {
+            std::vector<std::pair<double,voicing> > vs;
+            cg->find_best_voicings(seq, 10, 1.0, 1.75, 1.4, vs);
+        };
+        cases.push_back(bc);
+        bc.name = "TransitionNetwork::find_near_optimal_voicings " + name;
+        bc.run = [&cg,seq]() {
+            std::vector<std::pair<double,voicing> > vs;
+            cg->find_near_optimal_voicings(seq, 0.02, true, 1.0, 1.75, 1.4, vs);
+        };
+        cases.push_back(bc);
+    }
+    /* voicing all prefixes of the sequences, as when the chords are entered one by one */
+    bc.name = "TransitionNetwork::find_voicing (all prefixes)";
+    bc.run = [&cg,seqs]() {
+        voicing v;
+        int z0;
+        for (std::vector<std::vector<Chord> >::const_iterator it = seqs.begin(); it != seqs.end(); ++it) {
+            for (std::vector<Chord>::const_iterator jt = it->begin(); jt != it->end(); ++jt) {
+                cg->find_voicing(std::vector<Chord>(it->begin(), jt + 1), z0, 1.0, 1.75, 1.4, v);
+            }
+        }
+    };
+    cases.push_back(bc);
+    bc.name = "VoicingCache::find_voicing (all prefixes)";
+    bc.run = [&cg,seqs]() {
+        VoicingCache cache(*cg);
+        voicing v;
+        int z0;
+        for (std::vector<std::vector<Chord> >::const_iterator it = seqs.begin(); it != seqs.end(); ++it) {
+            for (std::vector<Chord>::const_iterator jt = it->begin(); jt != it->end(); ++jt) {
+                cache.find_voicing(std::vector<Chord>(it->begin(), jt + 1), z0, 1.0, 1.75, 1.4, v);
+            }
+        }
+    };
+    cases.push_back(bc);
+    /* voicing the sequences in all keys (the cache is emptied before each run) */
+    std::vector<std::vector<Chord> > keys;
+    for (std::vector<std::vector<Chord> >::const_iterator it = seqs.begin(); it != seqs.end(); ++it) {
+        for (int k = 0; k < 12; ++k) {
+            std::vector<Chord> seq;
+            for (std::vector<Chord>::const_iterator jt = it->begin(); jt != it->end(); ++jt) {
+                Chord c(*jt);
+                c.set_root(c.root() + k);
+                seq.push_back(Chord::from_id(c.id()));
+            }
+            keys.push_back(seq);
+        }
+    }
+    bc.name = "TransitionNetwork::find_voicing (all keys)";
+    bc.run = [&cg,keys]() {
+        voicing v;
+        int z0;
+        for (std::vector<std::vector<Chord> >::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+            cg->find_voicing(*it, z0, 1.0, 1.75, 1.4, v);
+        }
+    };
+    cases.push_back(bc);
+    bc.name = "TranspositionCache::find_voicing (all keys)";
+    bc.run = [&tc,keys]() {
+        voicing v;
+        int z0;
+        tc->clear();
+        for (std::vector<std::vector<Chord> >::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+            tc->find_voicing(*it, z0, 1.0, 1.75, 1.4, v);
+        }
+    };
+    cases.push_back(bc);
+    /* replacing single chords in a long progression, which chains the sequences in all keys */
+    bc.name = "TransitionNetwork::find_voicing (edits)";
+    bc.run = [&cg,&all_chords,keys]() {
+        std::vector<Chord> seq = chain(*cg, keys, 200);
+        voicing v;
+        int z0;
+        for (int i = 0; i < int(seq.size()); i += 20) {
+            Chord c = seq[i];
+            seq[i] = replacement(*cg, seq, i, all_chords);
+            cg->find_voicing(seq, z0, 1.0, 1.75, 1.4, v);
+            seq[i] = c;
+        }
+    };
+    cases.push_back(bc);
+    bc.name = "VoicingEditor::replace (edits)";
+    bc.run = [&cg,&all_chords,keys]() {
+        std::vector<Chord> progression = chain(*cg, keys, 200);
+        std::vector<double> wgh;
+        wgh.push_back(1.0);
+        wgh.push_back(1.75);
+        wgh.push_back(1.4);
+        VoicingEditor editor(*cg, wgh);
+        editor.assign(progression);
+        voicing v;
+        for (int i = 0; i < int(progression.size()); i += 20) {
+            editor.replace(i, replacement(*cg, progression, i, all_chords));
+            editor.find_voicing(v);
+            editor.replace(i, progression[i]);
+        }
+    };
+    cases.push_back(bc);
+    /* voicing a long progression, which chains the sequences in all keys */
+    bc.name = "TransitionNetwork::find_voicing (long)";
+    bc.run = [&cg,keys]() {
+        voicing v;
+        int z0;
+        cg->find_voicing(chain(*cg, keys, 1000), z0, 1.0, 1.75, 1.4, v);
+    };
+    cases.push_back(bc);
+    bc.name = "TransitionNetwork::find_voicing_parallel (long)";
+    bc.run = [&cg,keys]() {
+        voicing v;
+        int z0;
+        cg->find_voicing_parallel(chain(*cg, keys, 1000), 0, z0, 1.0, 1.75, 1.4, v);
+    };
+    cases.push_back(bc);
+    /* calibrating the weights on a progression, which chains the sequences in all keys */
+    std::vector<std::vector<double> > grid;
+    for (int i = 0; i < 5; ++i) {
+        for (int j = 0; j < 5; ++j) {
+            std::vector<double> wgh;
+            wgh.push_back(0.5 + 0.25 * i);
+            wgh.push_back(1.25 + 0.25 * j);
+            wgh.push_back(1.4);
+            grid.push_back(wgh);
+        }
+    }
+    bc.name = "TransitionNetwork::find_voicing (weight grid)";
+    bc.run = [&cg,keys,grid]() {
+        std::vector<Chord> seq = chain(*cg, keys, 100);
+        voicing v;
+        int z0;
+        for (std::vector<std::vector<double> >::const_iterator it = grid.begin(); it != grid.end(); ++it) {
+            cg->find_voicing(seq, z0, (*it)[0], (*it)[1], (*it)[2], v);
+        }
+    };
+    cases.push_back(bc);
+    bc.name = "TransitionNetwork::sweep_weights (weight grid)";
+    bc.run = [&cg,keys,grid]() {
+        std::vector<voicing> vs;
+        std::vector<double> weights;
+        ivector z0, same;
+        cg->sweep_weights(chain(*cg, keys, 100), grid, vs, weights, z0, same);
+    };
+    cases.push_back(bc);
+    bc.name = "TransitionNetwork::find_pareto_voicings (weight grid)";
+    bc.run = [&cg,keys]() {
+        std::vector<std::pair<std::vector<double>,voicing> > vs;
+        ivector z0;
+        cg->find_pareto_voicings(chain(*cg, keys, 20), vs, z0);
+    };
+    cases.push_back(bc);
+    /* parsing sequence files */
+    bc.name = "Corpus::open";
+    bc.run = [seq_dir,seq_files]() {
+        for (std::vector<std::string>::const_iterator it = seq_files.begin(); it != seq_files.end(); ++it) {
+            Corpus corpus;
+            corpus.open((seq_dir + "/" + *it).c_str());
+        }
+    };
+    cases.push_back(bc);
+    /* paths in chord graphs */
+    ChordGraph *wcg = NULL;
+    bc.name = "Digraph::yen (genprog)";
+    bc.run = [&wcg]() {
+        std::vector<ivector> paths;
+        int src = wcg->find_vertex_by_chord(Chord(0, DOMINANT_SEVENTH));
+        int dest = wcg->find_vertex_by_chord(Chord(7, MINOR_SEVENTH));
+        wcg->enable_all_vertices();
+        wcg->enable_all_arcs();
+        wcg->yen(src, dest, 10, 0, 0, paths);
+    };
+    cases.push_back(bc);
+    bc.name = "ChordGraph::find_fixed_length_paths";
+    bc.run = [&cg]() {
+        std::vector<ivector> paths;
+        int src = cg->find_vertex_by_chord(Chord(0, DOMINANT_SEVENTH));
+        int dest = cg->find_vertex_by_chord(Chord(7, MINOR_SEVENTH));
+        srand(1);
+        cg->find_fixed_length_paths(src, dest, 4, 10, paths);
+    };
+    cases.push_back(bc);
+    if (list_only) {
+        for (std::vector<bench_case>::const_iterator it = cases.begin(); it != cases.end(); ++it) {
+            std::cout << it->name << std::endl;
+        }
+        return 0;
+    }
+    bool first = true;
+    for (std::vector<bench_case>::const_iterator it = cases.begin(); it != cases.end(); ++it) {
+        if (!filter.empty() && it->name.find(filter) == std::string::npos)
+            continue;
+        if (cg == NULL && (it->name.find("TransitionNetwork") == 0 || it->name.find("RealizationGraph") == 0 ||
+                           it->name.find("VoicingCache") == 0 || it->name.find("TranspositionCache") == 0 ||
+                           it->name.find("VoicingEditor") == 0 || it->name.find("find_fixed_length_paths") != std::string::npos))
+            cg = new ChordGraph(all_chords, 7, dom, NO_PREPARATION, true, false, 0);
+        if (rg == NULL && it->name.find("RealizationGraph::find_voicing") == 0)
+            rg = new RealizationGraph(*cg);
+        if (tc == NULL && it->name.find("TranspositionCache::find_voicing") == 0)
+            tc = new TranspositionCache(*cg);
+        if (wcg == NULL && it->name.find("yen") != std::string::npos) {
+            /* set the weights as in example/genprog.cpp */
+            wcg = new ChordGraph(all_chords, 7, dom, PREPARE_GENERIC, false, false, 0, true);
+            int n = wcg->number_of_vertices();
+            for (int i = 1; i <= n; ++i) {
+                for (int j = 1; j <= n; ++j) {
+                    if (i == j || wcg->arc(i, j) == NULL)
+                        continue;
+                    const std::set<Transition> &tr = wcg->transitions(i, j);
+                    double min_ls = DBL_MAX;
+                    for (std::set<Transition>::const_iterator kt = tr.begin(); kt != tr.end(); ++kt) {
+                        double ls = (1.0 + kt->directional_vl_shift()) / kt->vl_shift();
+                        if (min_ls > ls)
+                            min_ls = ls;
+                    }
+                    wcg->set_weight(i, j, min_ls);
+                }
+            }
+        }
+        output_result(measure(*it, reps), format, first);
+        first = false;
+    }
+    if (format == "json")
+        std::cout << (first ? "[]\n" : "\n]\n");
+    delete tc;
+    delete rg;
+    delete cg;
+    delete wcg;
+    return 0;
+}
@@ -20,13 +20,24 @@
 
 #include "src/chordgraph.h"
 #include "src/transitionnetwork.h"
+#include "src/transitionstatistics.h"
+#include "src/profile.h"
+#include "src/voicingstream.h"
+#include "src/corpus.h"
+#include "src/corpusstatistics.h"
+#include "src/realizationgraph.h"
 #include <glpk.h>
 #include <assert.h>
+#include <float.h>
 #include <string.h>
 #include <iostream>
 #include <string>
 #include <sstream>
-#include <ctime>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
 
 static void show_usage(std::string name) {
     std::cerr << "Usage: " << name << " <task> [<option(s)>] CHORDS or FILE\n"
@@ -39,6 +50,9 @@ static void show_usage(std::string name) {
               << " -v, --voicing            Output optimal voicing for the given chord sequence\n"
               << " -av,--all-voicings       Output all optimal voicings for the given chord sequence\n"
               << " -mn,--Pmn-relations      Output all (m,n) such that the given two chords are Pmn-related\n"
+              << " -sv,--stream-voicing     Output voicing for the chord sequence while reading it (use '-' for standard input)\n"
+              << " -ca,--corpus-analysis    Voice all sequences in the given files or directories and output statistics\n"
+              << " -mg,--merge              Merge the given statistics snapshots and output the combined statistics\n"
               << "Options:\n"
               << " -c, --class              Specify upper bound for voice-leading infinity norm\n"
               << " -dg,--degree             Specify degree of elementary transitions\n"
@@ -50,11 +64,22 @@ static void show_usage(std::string name) {
               << " -z, --tonal-center       Specify tonal center on the line of fifths\n"
               << " -lf,--label-format       Specify format for chord graph labels\n"
               << " -p, --preparation        Specify preparation scheme for elementary transitions\n"
-              << " -w, --weights            Specify weight parameters for voicing algorithm\n"
+              << " -w, --weights            Specify weight parameters for voicing algorithm (may be repeated to voice for each)\n"
               << " -wv,--worst-voicing      Output worst instead of best voicing\n"
+              << " -kb,--k-best             Output the given number of best voicings, ranked by weight\n"
+              << " -to,--tolerance          Output all voicings within the given tolerance (absolute, or relative if followed by %) of the optimum\n"
+              << " -cn,--count              Output only the number of voicings found\n"
+              << " -pf,--pareto-front       Output Pareto-optimal voicings with their spread, voice-leading and augmented-sixth components\n"
+              << " -bw,--beam               Find voicing by beam search of the given width, doubled while time remains\n"
+              << " -dl,--deadline-ms        Specify time limit in milliseconds for beam search, after which the best voicing found is output\n"
+              << " -lg,--lag                Specify the number of chords received before a realization is committed\n"
+              << " -j, --threads            Specify the number of worker threads (default: all hardware threads)\n"
+              << " -ss,--snapshot           Write a mergeable snapshot of the statistics to the given file\n"
               << " -vc,--vertex-centrality  Show centrality measure with each vertex of the chord graph\n"
               << " -ly,--lilypond           Output transitions and voicings in Lilypond code\n"
               << " -cs,--chord-symbols      Print chord symbols above realizations in Lilypond output\n"
+              << " -pr,--profile            Output timings and counters for library routines, either as 'table' or 'json'\n"
+              << " -pt,--profile-trace      Write timeline of profiled routines to the given file in Chrome trace format\n"
               << " -q, --quiet              Suppress messages"
               << std::endl;
 }
@@ -90,6 +115,86 @@ static void output_transitions(const std::vector<Transition> &trans, Preparation
     } else std::cout << trans;
 }
 
+static void output_statistics(const TransitionStatistics &stats) {
+    std::cout << "Total transitions: " << stats.total() << "\n"
+              << "Efficient transitions: " << stats.efficient() << " (" << stats.efficient_percentage() << "%)\n"
+              << "Average voice-leading shift: " << stats.average_vl_shift() << " semitones\n"
+              << "Average relative excess: " << stats.average_relative_excess() * 100.0 << "%\n"
+              << "Common tones are fixed in " << stats.fixed_common_tones() << " transitions\n"
+              << "Contrary motion occurs in " << stats.contrary_motion() << " transitions\n"
+              << "Distribution by voice-leading shift:\n";
+    const std::map<int,int> &vl_map = stats.vl_shift_distribution();
+    for (std::map<int,int>::const_iterator it = vl_map.begin(); it != vl_map.end(); ++it) {
+        std::cout << it->first << ": " << it->second << "\n";
+    }
+    std::cout << "Distribution over mn-pair types:\n";
+    const std::map<ipair,int> &vlp_map = stats.mn_type_distribution();
+    for (std::map<ipair,int>::const_iterator it = vlp_map.begin(); it != vlp_map.end(); ++it) {
+        std::cout << it->first << ": " << it->second << "\n";
+    }
+}
+
+static std::string key_signature(int z0) {
+    return std::to_string(abs(z0)) + (z0 == 0 ? " sharps/flats" : (z0 > 0 ? " sharps" : " flats"));
+}
+
+static void output_corpus_statistics(const CorpusStatistics &stats) {
+    std::cout << "Voiced sequences: " << stats.sequences() << "\n"
+              << "Chords: " << stats.chords() << "\n"
+              << "Enharmonic cues: " << stats.cues() << "\n"
+              << "Augmented sixths: " << stats.augmented() << " in " << stats.augmented_sequences() << " sequences\n"
+              << "Recommended key signatures:\n";
+    const std::map<int,int> &ks_map = stats.key_signatures();
+    for (std::map<int,int>::const_iterator it = ks_map.begin(); it != ks_map.end(); ++it) {
+        std::cout << key_signature(it->first) << ": " << it->second << "\n";
+    }
+    output_statistics(stats.transitions());
+    /* transition types by decreasing frequency */
+    const std::map<ivector,std::pair<int,Transition> > &types = stats.transition_types();
+    std::vector<std::pair<int,const Transition*> > tv;
+    for (std::map<ivector,std::pair<int,Transition> >::const_iterator it = types.begin(); it != types.end(); ++it) {
+        tv.push_back(std::make_pair(-it->second.first, &it->second.second));
+    }
+    std::stable_sort(tv.begin(), tv.end(), [](const std::pair<int,const Transition*> &a, const std::pair<int,const Transition*> &b) {
+        return a.first < b.first;
+    });
+    std::cout << "Transition types (" << tv.size() << "):\n";
+    for (std::vector<std::pair<int,const Transition*> >::const_iterator it = tv.begin(); it != tv.end(); ++it) {
+        std::cout << -it->first << ": " << *it->second << "\n";
+    }
+}
+
+template<class T>
+static bool write_snapshot(const std::string &filename, const T &stats) {
+    std::ofstream ofs(filename.c_str());
+    if (!ofs)
+        return false;
+    stats.write_json(ofs);
+    ofs << std::endl;
+    return ofs.good();
+}
+
+static bool is_directory(const std::string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static std::vector<std::string> list_sequence_files(const std::string &dirname) {
+    std::vector<std::string> files;
+    DIR *dir = opendir(dirname.c_str());
+    if (dir == NULL)
+        return files;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        std::string name = ent->d_name;
+        if (name.size() > 4 && name.substr(name.size() - 4) == ".seq")
+            files.push_back(dirname + "/" + name);
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
 static void isolate_degree(std::vector<Transition> &trans, int deg) {
     if (deg > 0) {
         for (int i = trans.size(); i-->0;) {
@@ -104,14 +209,18 @@ int main(int argc, char *argv[]) {
         show_usage(argv[0]);
         return 1;
     }
-    int task = 0, deg = 0, cls = 7, z = 0, lily = 0;
+    int task = 0, deg = 0, cls = 7, z = 0, lily = 0, lag = 4, num_threads = 0, k_best = 0, beam = 0, deadline_ms = -1;
     double w1 = 1.0, w2 = 1.75, w3 = 1.4;
     bool aug = false, faug = false, respell = true, verbose = true, cs = false, best = true, simp = true;
+    bool relative_tol = false, count_only = false, pareto = false;
+    std::vector<std::vector<double> > weight_sweep;
+    double tol = -1;
     PreparationScheme prep_scheme = NO_PREPARATION;
     std::string label_format = "symbol", vc_format = "none";
-    std::string input_filename = "";
+    std::string input_filename = "", profile_format = "none", trace_filename = "", snapshot_filename = "";
     Domain domain = Domain::usual();
     std::vector<Chord> chords;
+    std::vector<std::string> input_paths;
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (i == 1) { // parse task
@@ -132,6 +241,12 @@ int main(int argc, char *argv[]) {
                 task = 6;
             } else if (arg == "-ts" || arg == "--transition-stats") {
                 task = 7;
+            } else if (arg == "-sv" || arg == "--stream-voicing") {
+                task = 8;
+            } else if (arg == "-ca" || arg == "--corpus-analysis") {
+                task = 9;
+            } else if (arg == "-mg" || arg == "--merge") {
+                task = 10;
             } else {
                 std::cerr << "Error: invalid task specification" << std::endl;
                 return 1;
@@ -255,6 +370,11 @@ int main(int argc, char *argv[]) {
                                   << std::endl;
                         return 1;
                     }
+                    std::vector<double> wgh;
+                    wgh.push_back(w1);
+                    wgh.push_back(w2);
+                    wgh.push_back(w3);
+                    weight_sweep.push_back(wgh);
                 } else {
                     std::cerr << "Error: --weights requires three arguments" << std::endl;
                     return 1;
@@ -265,8 +385,116 @@ int main(int argc, char *argv[]) {
                 cs = true;
             } else if (arg == "-wv" || arg == "--worst-voicing") {
                 best = false;
+            } else if (arg == "-kb" || arg == "--k-best") {
+                if (i + 1 < argc) {
+                    k_best = atoi(argv[++i]);
+                    if (k_best <= 0) {
+                        std::cerr << "Error: invalid number of voicings, expected a positive integer" << std::endl;
+                        return 1;
+                    }
+                } else {
+                    std::cerr << "Error: --k-best requires one argument" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "-to" || arg == "--tolerance") {
+                if (i + 1 < argc) {
+                    std::string val = argv[++i];
+                    relative_tol = !val.empty() && val[val.size() - 1] == '%';
+                    if (relative_tol)
+                        val.erase(val.size() - 1);
+                    char *end;
+                    tol = strtod(val.c_str(), &end);
+                    if (val.empty() || *end != '\0' || tol < 0) {
+                        std::cerr << "Error: invalid tolerance, expected a nonnegative floating-point value" << std::endl;
+                        return 1;
+                    }
+                    if (relative_tol)
+                        tol /= 100;
+                } else {
+                    std::cerr << "Error: --tolerance requires one argument" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "-bw" || arg == "--beam") {
+                if (i + 1 < argc) {
+                    beam = atoi(argv[++i]);
+                    if (beam <= 0) {
+                        std::cerr << "Error: invalid beam width, expected a positive integer" << std::endl;
+                        return 1;
+                    }
+                } else {
+                    std::cerr << "Error: --beam requires one argument" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "-dl" || arg == "--deadline-ms") {
+                if (i + 1 < argc) {
+                    std::string val = argv[++i];
+                    if (val.find_first_not_of("0123456789") != std::string::npos || val.empty()) {
+                        std::cerr << "Error: invalid deadline, expected a nonnegative integer" << std::endl;
+                        return 1;
+                    }
+                    deadline_ms = atoi(val.c_str());
+                } else {
+                    std::cerr << "Error: --deadline-ms requires one argument" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "-cn" || arg == "--count") {
+                count_only = true;
+            } else if (arg == "-pf" || arg == "--pareto-front") {
+                pareto = true;
             } else if (arg == "-q" || arg == "--quiet") {
                 verbose = false;
+            } else if (arg == "-lg" || arg == "--lag") {
+                if (i + 1 < argc) {
+                    std::string val = argv[++i];
+                    if (val.find_first_not_of("0123456789") != std::string::npos || val.empty()) {
+                        std::cerr << "Error: invalid lag specification, expected a nonnegative integer" << std::endl;
+                        return 1;
+                    }
+                    lag = atoi(val.c_str());
+                } else {
+                    std::cerr << "Error: --lag requires one argument" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "-j" || arg == "--threads") {
+                if (i + 1 < argc) {
+                    num_threads = atoi(argv[++i]);
+                    if (num_threads <= 0) {
+                        std::cerr << "Error: invalid number of threads, expected a positive integer" << std::endl;
+                        return 1;
+                    }
+                } else {
+                    std::cerr << "Error: --threads requires one argument" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "-pr" || arg == "--profile") {
+                if (i + 1 < argc) {
+                    profile_format = argv[++i];
+                    if (profile_format != "table" && profile_format != "json") {
+                        std::cerr << "Error: invalid profile format, expected either 'table' or 'json'" << std::endl;
+                        return 1;
+                    }
+                } else {
+                    std::cerr << "Error: --profile requires one argument" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "-pt" || arg == "--profile-trace") {
+                if (i + 1 < argc) {
+                    trace_filename = argv[++i];
+                } else {
+                    std::cerr << "Error: --profile-trace requires one argument" << std::endl;
+                    return 1;
+                }
+            } else if (arg == "-ss" || arg == "--snapshot") {
+                if (i + 1 < argc) {
+                    snapshot_filename = argv[++i];
+                } else {
+                    std::cerr << "Error: --snapshot requires one argument" << std::endl;
+                    return 1;
+                }
+            } else if (task == 9 || task == 10) { // parse files and directories, or snapshots
+                for (; i < argc; ++i) {
+                    input_paths.push_back(argv[i]);
+                }
             } else { // parse chords or file
                 for (; i < argc; ++i) {
                     Chord c(argv[i]);
@@ -309,48 +537,57 @@ int main(int argc, char *argv[]) {
             }
         }
     }
-    if (!input_filename.empty()) { // read chords from file
+    bool use_stdin = task == 8 && input_filename == "-";
+    if (!input_filename.empty() && !use_stdin) { // read chords from file
         assert(chords.empty());
-        std::ifstream ifs;
-        ifs.open(input_filename);
-        if (!ifs.is_open()) {
-            std::cerr << "Error: failed to open file '" << input_filename << "'" << std::endl;
+        Corpus corpus;
+        if (!corpus.open(input_filename.c_str())) {
+            std::cerr << "Error: " << corpus.error() << std::endl;
             return 1;
         }
-        std::string line;
-        std::stringstream ss;
-        while (std::getline(ifs, line)) {
-            if (line.front() == '#')
-                continue;
-            if (ss.str().size() > 0)
-                ss << " ";
-            ss << line;
-        }
-        std::string contents = ss.str();
-        char *ct = new char[contents.size()+1];
-        strcpy(ct, contents.c_str());
-        const char *delim = ",; \t";
-        char *symb = strtok(ct, delim);
-        while (symb != NULL) {
-            if (strlen(symb) > 0) {
-                Chord c(symb);
-                if (!c.is_valid()) {
-                    std::cerr << "Error reading input file: '" << symb << "' is not a chord" << std::endl;
-                    return 1;
-                }
-                chords.push_back(c);
+        /* sequences separated by blank lines are joined */
+        chords.reserve(corpus.total_chords());
+        for (int k = 0; k < corpus.size(); ++k) {
+            const unsigned char *ids = corpus.ids(k);
+            for (int i = 0; i < corpus.length(k); ++i) {
+                chords.push_back(Chord::from_id(ids[i]));
             }
-            symb = strtok(NULL, delim);
         }
-        delete[] ct;
     }
-    if (chords.empty()) {
+    std::vector<std::vector<Chord> > corpus_seqs;
+    if (task == 9) { // read sequences from files
+        std::vector<std::string> files;
+        for (std::vector<std::string>::const_iterator it = input_paths.begin(); it != input_paths.end(); ++it) {
+            if (is_directory(*it)) {
+                std::vector<std::string> dir_files = list_sequence_files(*it);
+                files.insert(files.end(), dir_files.begin(), dir_files.end());
+            } else files.push_back(*it);
+        }
+        for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++it) {
+            Corpus corpus;
+            if (!corpus.open(it->c_str())) {
+                std::cerr << "Error: " << corpus.error() << " in '" << *it << "'" << std::endl;
+                return 1;
+            }
+            for (int k = 0; k < corpus.size(); ++k) {
+                corpus_seqs.push_back(std::vector<Chord>());
+                corpus.sequence(k, corpus_seqs.back());
+            }
+        }
+        if (corpus_seqs.empty()) {
+            std::cerr << "Error: no sequences found" << std::endl;
+            return 1;
+        }
+    } else if (task == 10 && input_paths.empty()) {
+        std::cerr << "Error: no snapshots given" << std::endl;
+        return 1;
+    } else if (task != 10 && chords.empty() && !use_stdin) {
         std::cerr << "Error: no chords found" << std::endl;
         return 1;
     }
     if (lily && cs)
         lily = 2;
-    if (verbose && task <= 3)
+    if (verbose && (task <= 3 || task == 8 || task == 9))
         std::cerr << "Using GLPK " << glp_version() << std::endl;
     if (task == 1 || task == 4 || task == 5) { // delete chord duplicates
         int ndup = 0;
@@ -365,7 +602,9 @@ int main(int argc, char *argv[]) {
         if (ndup > 0 && verbose)
             std::cerr << "Warning: removed " << ndup << " chord duplicate(s)" << std::endl;
     }
-    std::clock_t clock_start = clock();
+    if (profile_format != "none" || !trace_filename.empty())
+        Profile::enable(!trace_filename.empty());
+    std::chrono::steady_clock::time_point clock_start = std::chrono::steady_clock::now();
     if (task == 1) { // create chord graph
         if (verbose)
             std::cerr << "Creating chord graph for " << chords.size() << " chords..." << std::endl;
@@ -382,6 +621,98 @@ int main(int argc, char *argv[]) {
                       << cg.number_of_vertices() << " vertices and "
                       << ne << (is_undirected ? " edges" : " arcs") << std::endl;
         cg.export_dot("-", is_undirected);
+    } else if (task == 2 && pareto) { // find Pareto-optimal voicings
+        if (!best || k_best > 0 || beam > 0 || deadline_ms >= 0 || weight_sweep.size() > 1) {
+            std::cerr << "Error: --pareto-front cannot be combined with --worst-voicing, --k-best, beam search or several weight vectors"
+                      << std::endl;
+            return 1;
+        }
+        if (verbose)
+            std::cerr << "Finding Pareto-optimal voicings for the sequence " << chords << std::endl;
+        std::vector<Chord> all_chords = Chord::all_seventh_chords();
+        ChordGraph cg(all_chords, cls, domain, prep_scheme, aug, false, 0, false, false);
+        std::vector<std::pair<std::vector<double>,voicing> > vs;
+        ivector z0;
+        if (cg.find_pareto_voicings(chords, vs, z0)) {
+            if (verbose)
+                std::cerr << "Found " << vs.size() << " voicing(s)" << std::endl;
+            for (int i = 0; i < int(vs.size()); ++i) {
+                const std::vector<double> &c = vs[i].first;
+                std::cout << std::endl << "Voicing #" << i + 1 << " (spread " << c[0] << ", voice leading " << c[1]
+                          << ", augmented sixths " << c[2] << ", key signature " << key_signature(z0[i]) << "):" << std::endl;
+                std::cout << vs[i].second;
+            }
+        } else std::cerr << "Error: the given progression does not match chord graph specifications" << std::endl;
+    } else if (task == 2 && weight_sweep.size() > 1) { // find voicings for several weight vectors
+        if (!best || k_best > 0 || beam > 0 || deadline_ms >= 0) {
+            std::cerr << "Error: several weight vectors cannot be combined with --worst-voicing, --k-best or beam search"
+                      << std::endl;
+            return 1;
+        }
+        if (verbose)
+            std::cerr << "Finding optimal voicings for " << weight_sweep.size() << " weight vectors for the sequence "
+                      << chords << std::endl;
+        std::vector<Chord> all_chords = Chord::all_seventh_chords();
+        ChordGraph cg(all_chords, cls, domain, prep_scheme, aug, false, 0, false, false);
+        std::vector<voicing> vs;
+        std::vector<double> weights;
+        ivector z0, same;
+        if (cg.sweep_weights(chords, weight_sweep, vs, weights, z0, same)) {
+            for (int i = 0; i < int(vs.size()); ++i) {
+                const std::vector<double> &wgh = weight_sweep[i];
+                std::cout << std::endl << "Voicing #" << i + 1 << " for weights " << wgh[0] << ", " << wgh[1] << ", " << wgh[2]
+                          << " (weight " << weights[i] << ", key signature " << key_signature(z0[i]) << ")";
+                if (same[i] < i)
+                    std::cout << ": same as voicing #" << same[i] + 1 << std::endl;
+                else std::cout << ":" << std::endl << vs[i];
+            }
+        } else std::cerr << "Error: the given progression does not match chord graph specifications" << std::endl;
+    } else if (task == 2 && (beam > 0 || deadline_ms >= 0)) { // find voicing by beam search
+        if (!best || k_best > 0) {
+            std::cerr << "Error: beam search cannot be combined with --worst-voicing or --k-best" << std::endl;
+            return 1;
+        }
+        if (beam == 0)
+            beam = 16;
+        if (deadline_ms < 0)
+            deadline_ms = 0;
+        if (verbose)
+            std::cerr << "Finding voicing by beam search of width " << beam << " within " << deadline_ms
+                      << " ms for the sequence " << chords << std::endl;
+        std::vector<Chord> all_chords = Chord::all_seventh_chords();
+        ChordGraph cg(all_chords, cls, domain, prep_scheme, aug, false, 0, false, false);
+        voicing v;
+        int z0;
+        double weight, bound;
+        if (cg.find_voicing_beam(chords, beam, deadline_ms, z0, w1, w2, w3, v, weight, bound)) {
+            std::cout << "Voicing (weight " << weight;
+            if (bound == weight)
+                std::cout << ", optimal";
+            else if (bound > -DBL_MAX)
+                std::cout << ", lower bound " << bound << ", gap " << weight - bound;
+            std::cout << "):" << std::endl << v;
+            if (verbose)
+                std::cerr << "Recommended key signature: " << key_signature(z0) << std::endl;
+        } else std::cerr << "Error: the given progression does not match chord graph specifications" << std::endl;
+    } else if (task == 2 && k_best > 0) { // find k best voicings
+        if (!best) {
+            std::cerr << "Error: --k-best cannot be combined with --worst-voicing" << std::endl;
+            return 1;
+        }
+        if (verbose)
+            std::cerr << "Finding " << k_best << " best voicing(s) for the sequence " << chords << std::endl;
+        std::vector<Chord> all_chords = Chord::all_seventh_chords();
+        ChordGraph cg(all_chords, cls, domain, prep_scheme, aug, false, 0, false, false);
+        std::vector<std::pair<double,voicing> > vs;
+        int i = 0;
+        if (cg.find_best_voicings(chords, k_best, w1, w2, w3, vs)) {
+            if (verbose)
+                std::cerr << "Found " << vs.size() << " voicing(s)" << std::endl;
+            for (std::vector<std::pair<double,voicing> >::const_iterator it = vs.begin(); it != vs.end(); ++it) {
+                std::cout << std::endl << "Voicing #" << ++i << " (weight " << it->first << "):" << std::endl;
+                std::cout << it->second;
+            }
+        } else std::cerr << "Error: the given progression does not match chord graph specifications" << std::endl;
     } else if (task == 2) { // find optimal voicing
         if (verbose)
             std::cerr << "Finding " << (best ? "optimal" : "worst") << " voicing for the sequence "
@@ -393,11 +724,34 @@ int main(int argc, char *argv[]) {
         if (cg.find_voicing(chords, z0, w1, w2, w3, v, best)) {
                 std::cout << v;
                 if (verbose) {
-                    std::cerr << "Recommended key signature: "
-                              << abs(z0) << (z0 == 0 ? " sharps/flats" : (z0 > 0 ? " sharps" : " flats"))
-                              << std::endl;
+                    std::cerr << "Recommended key signature: " << key_signature(z0) << std::endl;
                 }
         } else std::cerr << "Error: the given progression does not match chord graph specifications" << std::endl;
+    } else if (task == 3 && (tol >= 0 || count_only)) { // find all near-optimal voicings
+        if (tol < 0)
+            tol = 0;
+        if (verbose)
+            std::cerr << "Finding all voicings within " << (relative_tol ? 100 * tol : tol) << (relative_tol ? "%" : "")
+                      << " of the optimum for the sequence " << chords << std::endl;
+        std::vector<Chord> all_chords = Chord::all_seventh_chords();
+        ChordGraph cg(all_chords, cls, domain, prep_scheme, aug, false, 0, false, false);
+        if (count_only) {
+            unsigned long long count;
+            if (cg.count_near_optimal_voicings(chords, tol, relative_tol, w1, w2, w3, count))
+                std::cout << count << std::endl;
+            else std::cerr << "Error: the given progression does not match chord graph specifications" << std::endl;
+        } else {
+            std::vector<std::pair<double,voicing> > vs;
+            int i = 0;
+            if (cg.find_near_optimal_voicings(chords, tol, relative_tol, w1, w2, w3, vs)) {
+                if (verbose)
+                    std::cerr << "Found " << vs.size() << " voicing(s)" << std::endl;
+                for (std::vector<std::pair<double,voicing> >::const_iterator it = vs.begin(); it != vs.end(); ++it) {
+                    std::cout << std::endl << "Voicing #" << ++i << " (weight " << it->first << "):" << std::endl;
+                    std::cout << it->second;
+                }
+            } else std::cerr << "Error: the given progression does not match chord graph specifications" << std::endl;
+        }
     } else if (task == 3) { // find all optimal voicings
         if (verbose)
             std::cerr << "Finding all optimal voicings for the sequence " << chords << std::endl;
@@ -504,71 +858,137 @@ int main(int argc, char *argv[]) {
     } else if (task == 7) {
         if (verbose)
             std::cerr << "Computing transitions..." << std::endl;
-        std::vector<Transition> trans, lst;
-        for (std::vector<Chord>::const_iterator it = chords.begin(); it != chords.end(); ++it) {
-            for (std::vector<Chord>::const_iterator jt = chords.begin(); jt != chords.end(); ++jt) {
-                if (it == jt)
-                    continue;
-                lst = Transition::elementary_classes(*it, *jt, cls, prep_scheme, z, aug);
-                Transition::simplify_enharmonic_classes(lst, respell, simp);
-                trans.insert(trans.end(), lst.begin(), lst.end());
-            }
+        TransitionStatistics stats = TransitionStatistics::compute(chords, cls, prep_scheme, z, aug, respell, simp);
+        if (verbose && stats.duplicates() > 0)
+            std::cerr << "Removed " << stats.duplicates() << " duplicates" << std::endl;
+        output_statistics(stats);
+        if (!snapshot_filename.empty() && !write_snapshot(snapshot_filename, stats)) {
+            std::cerr << "Error: failed to write snapshot to " << snapshot_filename << std::endl;
+            return 1;
         }
-        int erased_count = 0;
-        for (int i = 0; i < int(trans.size()); ++i) {
-            for (int j = trans.size(); j-->i+1;) {
-                if (trans[i].is_congruent(trans[j]) ||
-                        (prep_scheme == NO_PREPARATION && trans[i].is_congruent(trans[j].retrograde()))) {
-                    trans.erase(trans.begin() + j);
-                    ++erased_count;
+        if (verbose)
+            std::cerr << "Done." << std::endl;
+    } else if (task == 8) { // voice chords as they arrive
+        std::vector<Chord> all_chords = Chord::all_seventh_chords();
+        ChordGraph cg(all_chords, cls, domain, prep_scheme, aug, false, 0, false, false);
+        std::vector<double> wgh;
+        wgh.push_back(w1);
+        wgh.push_back(w2);
+        wgh.push_back(w3);
+        VoicingStream vs(cg, wgh, lag);
+        voicing v;
+        std::string line, symb;
+        size_t pos = 0;
+        if (verbose)
+            std::cerr << "Voicing chords with lag " << lag << (use_stdin ? ", reading from standard input" : "") << std::endl;
+        while (true) {
+            if (pos == chords.size()) {
+                if (!use_stdin || !std::getline(std::cin, line))
+                    break;
+                chords.clear();
+                pos = 0;
+                if (line.empty() || line[0] == '#')
+                    continue;
+                for (std::string::iterator it = line.begin(); it != line.end(); ++it) {
+                    if (*it == ',' || *it == ';' || *it == '\t')
+                        *it = ' ';
+                }
+                std::istringstream ss(line);
+                while (ss >> symb) {
+                    Chord c(symb.c_str());
+                    if (!c.is_valid()) {
+                        std::cerr << "Error: '" << symb << "' is not a chord" << std::endl;
+                        return 1;
+                    }
+                    chords.push_back(c);
                 }
+                continue;
             }
+            v.clear();
+            if (!vs.push(chords[pos++], v)) {
+                std::cerr << "Error: the given progression does not match chord graph specifications" << std::endl;
+                return 1;
+            }
+            std::cout << v << std::flush;
         }
-        if (verbose && erased_count > 0)
-            std::cerr << "Removed " << erased_count << " duplicates" << std::endl;
-        int total = trans.size(), eff = 0, D, vls, vls_avg = 0, ct = 0, contrary = 0;
-        double pde = 0.0;
-        std::map<int,int> vl_map;
-        std::map<ipair,int> vlp_map;
-        ipair mn;
-        for (std::vector<Transition>::const_iterator it = trans.begin(); it != trans.end(); ++it) {
-            D = it->first().chord().vl_efficiency_metric(it->second().chord());
-            vls = it->vl_shift();
-            mn = it->mn_type();
-            ++vl_map[vls];
-            ++vlp_map[mn];
-            vls_avg += vls;
-            if (vls <= D)
-                ++eff;
-            else pde += (vls - D) / (double)D;
-            if (it->acts_identically_on_pc_intersection())
-                ++ct;
-            if (it->directional_vl_shift() < it->vl_shift())
-                ++contrary;
+        v.clear();
+        vs.flush(v);
+        std::cout << v << std::flush;
+        if (verbose && vs.committed() > 0) {
+            int z0 = vs.tonal_center();
+            std::cerr << "Recommended key signature: " << key_signature(z0) << std::endl;
         }
-        double eff_pc = (eff * 100.0) / (double)total;
-        double exc = pde / (double)total;
-        double vlsa = vls_avg / (double)total;
-        std::cout << "Total transitions: " << total << "\n"
-                  << "Efficient transitions: " << eff << " (" << eff_pc << "%)\n"
-                  << "Average voice-leading shift: " << vlsa << " semitones\n"
-                  << "Average relative excess: " << exc * 100.0 << "%\n"
-                  << "Common tones are fixed in " << ct << " transitions\n"
-                  << "Contrary motion occurs in " << contrary << " transitions\n"
-                  << "Distribution by voice-leading shift:\n";
-        for (std::map<int,int>::const_iterator it = vl_map.begin(); it != vl_map.end(); ++it) {
-            std::cout << it->first << ": " << it->second << "\n";
+    } else if (task == 9) { // analyze a corpus of sequences
+        if (verbose)
+            std::cerr << "Voicing " << corpus_seqs.size() << " sequences..." << std::endl;
+        std::vector<Chord> all_chords = Chord::all_seventh_chords();
+        ChordGraph cg(all_chords, cls, domain, prep_scheme, aug, false, 0, false, false);
+        std::vector<double> wgh;
+        wgh.push_back(w1);
+        wgh.push_back(w2);
+        wgh.push_back(w3);
+        /* precompiling the realization graph takes about as long as voicing a few dozen sequences without it */
+        CorpusStatistics stats;
+        if (corpus_seqs.size() >= 50) {
+            RealizationGraph rg(cg);
+            stats = CorpusStatistics::compute(rg, corpus_seqs, wgh, num_threads);
+        } else stats = CorpusStatistics::compute(cg, corpus_seqs, wgh, num_threads);
+        if (stats.failed() > 0)
+            std::cerr << "Warning: " << stats.failed() << " sequence(s) do not match chord graph specifications" << std::endl;
+        output_corpus_statistics(stats);
+        if (!snapshot_filename.empty() && !write_snapshot(snapshot_filename, stats)) {
+            std::cerr << "Error: failed to write snapshot to " << snapshot_filename << std::endl;
+            return 1;
         }
-        std::cout << "Distribution over mn-pair types:\n";
-        for (std::map<ipair,int>::const_iterator it = vlp_map.begin(); it != vlp_map.end(); ++it) {
-            std::cout << it->first << ": " << it->second << "\n";
+    } else if (task == 10) { // merge snapshots
+        /* the kind of the first snapshot determines the kind of the result */
+        TransitionStatistics trans_stats, ts;
+        CorpusStatistics corpus_stats, cs;
+        bool is_corpus = false;
+        for (std::vector<std::string>::const_iterator it = input_paths.begin(); it != input_paths.end(); ++it) {
+            std::ifstream ifs(it->c_str());
+            if (!ifs) {
+                std::cerr << "Error: failed to open file '" << *it << "'" << std::endl;
+                return 1;
+            }
+            JsonValue v;
+            std::string err;
+            if (!JsonValue::parse(ifs, v, err)) {
+                std::cerr << "Error: " << err << " in '" << *it << "'" << std::endl;
+                return 1;
+            }
+            if (it == input_paths.begin())
+                is_corpus = v.has("type") && v["type"].kind() == JsonValue::JSON_STRING && v["type"].string() == "corpus-statistics";
+            if (is_corpus ? !cs.read_json(v) : !ts.read_json(v)) {
+                std::cerr << "Error: '" << *it << "' is not a " << (is_corpus ? "corpus" : "transition")
+                          << " statistics snapshot" << std::endl;
+                return 1;
+            }
+            if (is_corpus)
+                corpus_stats.merge(cs);
+            else trans_stats.merge(ts);
         }
         if (verbose)
-            std::cerr << "Done." << std::endl;
+            std::cerr << "Merged " << input_paths.size() << " snapshots" << std::endl;
+        if (is_corpus)
+            output_corpus_statistics(corpus_stats);
+        else output_statistics(trans_stats);
+        if (!snapshot_filename.empty() &&
+                !(is_corpus ? write_snapshot(snapshot_filename, corpus_stats) : write_snapshot(snapshot_filename, trans_stats))) {
+            std::cerr << "Error: failed to write snapshot to " << snapshot_filename << std::endl;
+            return 1;
+        }
     } else assert(false);
-    std::clock_t clock_end = clock();
-    double elapsed_secs = double(clock_end - clock_start) / CLOCKS_PER_SEC;
+    std::chrono::duration<double> elapsed_secs = std::chrono::steady_clock::now() - clock_start;
     if (verbose)
-        std::cerr << "Time elapsed: " << elapsed_secs << " seconds" << std::endl;
+        std::cerr << "Time elapsed: " << elapsed_secs.count() << " seconds" << std::endl;
+    if (profile_format == "table")
+        Profile::write_table(std::cerr);
+    else if (profile_format == "json")
+        Profile::write_json(std::cerr);
+    if (!trace_filename.empty() && !Profile::write_trace(trace_filename.c_str())) {
+        std::cerr << "Error: failed to write profile trace to " << trace_filename << std::endl;
+        return 1;
+    }
     return 0;
 }
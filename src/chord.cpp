@@ -104,7 +104,7 @@ void Chord::set_type(int t) {
     _type = t % 5;
 }
 
-const int Chord::structure[][3] = {
+constexpr int Chord::structure[][3] = {
     {4, 7, 10}, {3, 6, 10}, {3, 7, 10}, {4, 7, 11}, {3, 6, 9}
 };
 
@@ -208,77 +208,110 @@ Chord Chord::structural_inversion() const {
     return Chord(r, t);
 }
 
-void Chord::remove_intersection(std::set<int> &pc1, std::set<int> &pc2) {
-    std::set<int> intr;
-    for (std::set<int>::const_iterator it = pc1.begin(); it != pc1.end(); ++it) {
-        if (pc2.find(*it) != pc2.end())
-            intr.insert(*it);
-    }
-    for (std::set<int>::const_iterator it = intr.begin(); it != intr.end(); ++it) {
-        pc1.erase(*it);
-        pc2.erase(*it);
+/* The relations between all pairs of the 51 seventh chords are tabulated at compile time.
+ * For each pair, pitch classes common to both chords are removed and the remaining
+ * pitch classes are matched in all possible ways (Douthett & Steinbach, 1998). */
+namespace {
+
+constexpr int pc_modd(int k) {
+    return (k % 12 + 12) % 12 > 6 ? 12 - (k % 12 + 12) % 12 : (k % 12 + 12) % 12;
+}
+
+constexpr int chord_pc(int id, int i) {
+    return id < 48 ? (id % 12 + (i == 0 ? 0 : Chord::structure[id / 12][i - 1])) % 12
+                   : (id - 48 + (i == 0 ? 0 : Chord::structure[DIMINISHED_SEVENTH][i - 1])) % 12;
+}
+
+constexpr unsigned int pmn_mask(const int *X, const int *Y, int n, int k, int used, int c1, int c2) {
+    if (k == n)
+        return 1u << (5 * c1 + c2);
+    unsigned int ret = 0;
+    for (int j = 0; j < n; ++j) {
+        if (used & (1 << j))
+            continue;
+        int d = pc_modd(X[k] - Y[j]);
+        if (d <= 2)
+            ret |= pmn_mask(X, Y, n, k + 1, used | (1 << j), c1 + (d == 1), c2 + (d == 2));
     }
+    return ret;
 }
 
-std::vector<int> Chord::set2vector(const std::set<int> &s) {
-    std::vector<int> ret;
-    ret.reserve(s.size());
-    for (std::set<int>::const_iterator it = s.begin(); it != s.end(); ++it) {
-        ret.push_back(*it);
+constexpr int min_shift(const int *X, const int *Y, int n, int k, int used) {
+    if (k == n)
+        return 0;
+    int ret = 12 * n;
+    for (int j = 0; j < n; ++j) {
+        if (used & (1 << j))
+            continue;
+        int w = pc_modd(X[k] - Y[j]) + min_shift(X, Y, n, k + 1, used | (1 << j));
+        if (w < ret)
+            ret = w;
     }
     return ret;
 }
 
-std::set<ipair> Chord::Pmn_relations(const Chord &other) const {
-    std::set<int> pc1 = this->pitch_class_set(), pc2 = other.pitch_class_set();
-    remove_intersection(pc1, pc2);
-    std::vector<int> p, X = set2vector(pc1), Y = set2vector(pc2);
-    int n = X.size();
-    for (int k = 0; k < n; ++k) {
-        p.push_back(k);
+struct ChordRelations {
+    int common_tones[51][51];
+    int vl_efficiency[51][51];
+    unsigned int pmn[51][51];
+
+    constexpr ChordRelations() : common_tones(), vl_efficiency(), pmn() {
+        for (int a = 0; a < 51; ++a) {
+            for (int b = 0; b < 51; ++b) {
+                int X[4] = {0, 0, 0, 0}, Y[4] = {0, 0, 0, 0}, n = 0, m = 0;
+                unsigned int P = 0, Q = 0;
+                for (int i = 0; i < 4; ++i) {
+                    P |= 1u << chord_pc(a, i);
+                    Q |= 1u << chord_pc(b, i);
+                }
+                for (int pc = 0; pc < 12; ++pc) {
+                    if ((P & ~Q) & (1u << pc))
+                        X[n++] = pc;
+                    if ((Q & ~P) & (1u << pc))
+                        Y[m++] = pc;
+                }
+                common_tones[a][b] = 4 - n;
+                vl_efficiency[a][b] = min_shift(X, Y, n, 0, 0);
+                pmn[a][b] = pmn_mask(X, Y, n, 0, 0, 0, 0);
+            }
+        }
     }
-    bool yes;
-    int c1, c2, d;
+};
+
+constexpr ChordRelations relations;
+
+}
+
+int Chord::id() const {
+    assert(is_valid());
+    return _type == DIMINISHED_SEVENTH ? 48 + _root % 3 : 12 * _type + _root;
+}
+
+Chord Chord::from_id(int id) {
+    assert(id >= 0 && id < 51);
+    return id < 48 ? Chord(id % 12, id / 12) : Chord(id - 48, DIMINISHED_SEVENTH);
+}
+
+std::set<ipair> Chord::Pmn_relations(const Chord &other) const {
+    unsigned int mask = Pmn_mask(other);
     std::set<ipair> res;
-    while (true) {
-        yes = true;
-        c1 = c2 = 0;
-        for (int k = 0; yes && k < n; ++k) {
-            d = Tone::modd(X[k] - Y[p[k]], 12);
-            if (d == 1)
-                ++c1;
-            else if (d == 2)
-                ++c2;
-            yes = (d <= 2);
-        }
-        if (yes)
-            res.insert(std::make_pair(c1, c2));
-        if (!std::next_permutation(p.begin(), p.end()))
-            break;
+    for (int b = 0; b < 25; ++b) {
+        if (mask & (1u << b))
+            res.insert(std::make_pair(b / 5, b % 5));
     }
     return res;
 }
 
+unsigned int Chord::Pmn_mask(const Chord &other) const {
+    return relations.pmn[id()][other.id()];
+}
+
 int Chord::vl_efficiency_metric(const Chord &other) const {
-    std::set<int> pc1 = this->pitch_class_set(), pc2 = other.pitch_class_set();
-    remove_intersection(pc1, pc2);
-    std::vector<int> X = set2vector(pc1), Y = set2vector(pc2), p;
-    int n = X.size();
-    for (int k = 0; k < n; ++k) {
-        p.push_back(k);
-    }
-    int w, minw = RAND_MAX;
-    while (true) {
-        w = 0;
-        for (int k = 0; k < n; ++k) {
-            w += Tone::modd(X[k] - Y[p[k]], 12);
-        }
-        if (w < minw)
-            minw = w;
-        if (!std::next_permutation(p.begin(), p.end()))
-            break;
-    }
-    return minw;
+    return relations.vl_efficiency[id()][other.id()];
+}
+
+int Chord::common_tone_count(const Chord &other) const {
+    return relations.common_tones[id()][other.id()];
 }
 
 std::vector<Chord> Chord::make_sequence_from_symbols(const char* symbols[], int len) {
@@ -43,8 +43,6 @@ class Chord {
 
     int _root;
     int _type;
-    static void remove_intersection(std::set<int> &pc1, std::set<int> &pc2);
-    static std::vector<int> set2vector(const std::set<int> &s);
 
 public:
     Chord();
@@ -65,6 +63,9 @@ public:
     int type() const;
     /* returns the type of this chord (0--4) */
 
+    int id() const;
+    /* returns the index (0--50) of this chord in the list returned by all_seventh_chords */
+
     bool is_valid() const;
     /* returns true iff 0 <= _root <= 11 and 0 <= _type <= 4 */
 
@@ -86,9 +87,15 @@ public:
     std::set<ipair> Pmn_relations(const Chord &other) const;
     /* returns the set of all P_{m,n} relations between this chord and other (Douthett & Steinbach, 1998) */
 
+    unsigned int Pmn_mask(const Chord &other) const;
+    /* returns the set of P_{m,n} relations as a bitmask, (m,n) corresponds to the bit 5*m+n */
+
     int vl_efficiency_metric(const Chord &other) const;
     /* returns the value of voice-leading efficiency metric (Harasim et.al, 2016) */
 
+    int common_tone_count(const Chord &other) const;
+    /* returns the number of pitch classes common to this chord and other */
+
     std::string to_string() const;
     /* returns a string representation */
 
@@ -104,6 +111,9 @@ public:
     Chord structural_inversion() const;
     /* returns the structural inversion about pc 2 (tone D) */
 
+    static Chord from_id(int id);
+    /* returns the chord with the given index (see id) */
+
     static std::vector<Chord> make_sequence_from_symbols(const char* symbols[], int len);
     /* returns the sequence of chords from array of chord symbols of length len */
 
@@ -20,6 +20,7 @@
 
 #include "chordgraph.h"
 #include "transitionnetwork.h"
+#include "profile.h"
 #include <assert.h>
 #include <math.h>
 
@@ -28,10 +29,12 @@ ChordGraph::ChordGraph(const std::vector<Chord> &chords, int k, const Domain &su
                        bool is_weighted, bool dot_tex) :
     Digraph(is_weighted, dot_tex)
 {
+    Profile::Timer timer("ChordGraph::ChordGraph");
     int i, j;
     _support = sup;
     M = k;
     _allows_aug = aug;
+    _prep = p;
     for (std::vector<Chord>::const_iterator it = chords.begin(); it != chords.end(); ++it) {
         if (Realization::tonal_realizations(*it, sup, aug).empty())
             continue;
@@ -39,6 +42,7 @@ ChordGraph::ChordGraph(const std::vector<Chord> &chords, int k, const Domain &su
         if (use_labels)
             set_vertex_name(i, (dot_tex ? it->to_tex() : it->to_string()).c_str());
         chord_map[i] = *it;
+        _vertex_cache[i];
     }
     std::set<Transition> bt;
     int n = number_of_vertices();
@@ -52,11 +56,14 @@ ChordGraph::ChordGraph(const std::vector<Chord> &chords, int k, const Domain &su
                 continue;
             glp_arc *a = add_arc(i, j);
             transition_map[a] = bt;
+            _arc_cache[a];
+            Profile::count(PROFILE_CHORD_GRAPH_ARCS);
         }
     }
     enable_all_vertices();
     enable_all_arcs();
     if (vc > 0) {
+        Profile::Timer vc_timer("ChordGraph::communicability_betweenness_centrality");
         _vc = std::vector<double>(n+1);
         _vc[0] = vc;
         for (int i = 1; i <= n; ++i) {
@@ -77,6 +84,10 @@ bool ChordGraph::allows_augmented_sixths() const {
     return _allows_aug;
 }
 
+PreparationScheme ChordGraph::preparation_scheme() const {
+    return _prep;
+}
+
 const std::set<Transition> &ChordGraph::transitions(glp_arc *a) const {
     assert(a != NULL);
     return transition_map.at(a);
@@ -86,6 +97,94 @@ const std::set<Transition> &ChordGraph::transitions(int i, int j) const {
     return transitions(arc(i, j));
 }
 
+int ChordGraph::GlueTable::size() const {
+    return _size;
+}
+
+const Transition &ChordGraph::GlueTable::transition(int k) const {
+    assert(k >= 0 && k < _size);
+    return *_trans[k];
+}
+
+int ChordGraph::GlueTable::target(int k) const {
+    assert(k >= 0 && k < _size);
+    return _targets[k];
+}
+
+const ChordGraph::GlueTable::entry *ChordGraph::GlueTable::row(int x) const {
+    assert(x >= 0 && (x + 1) * _size <= (int)_entries.size());
+    return _entries.data() + x * _size;
+}
+
+/* Realizations are compared by their voices, which is finer than Realization::operator ==. */
+ivector ChordGraph::realization_key(const Realization &r) {
+    ivector key(4);
+    for (int i = 0; i < 4; ++i) {
+        key[i] = r.tone(i).lof_position();
+    }
+    return key;
+}
+
+const ChordGraph::vertex_cache &ChordGraph::vertex_data(int i) const {
+    vertex_cache &vc = _vertex_cache.at(i);
+    std::call_once(vc.once, [&]() {
+        std::vector<Realization> R = Realization::tonal_realizations(vertex2chord(i), _support, _allows_aug);
+        size_t nt = R.size();
+        for (glp_arc *a = vertex(i)->in; a != NULL; a = a->h_next) {
+            const std::set<Transition> &ta = transitions(a);
+            for (std::set<Transition>::const_iterator it = ta.begin(); it != ta.end(); ++it) {
+                R.push_back(it->second());
+            }
+        }
+        for (std::vector<Realization>::const_iterator it = R.begin(); it != R.end(); ++it) {
+            if (vc.index.insert(std::make_pair(realization_key(*it), (int)vc.preds.size())).second)
+                vc.preds.push_back(*it);
+        }
+        assert(vc.preds.size() >= nt && vc.index.at(realization_key(R[nt-1])) == (int)nt - 1);
+    });
+    return vc;
+}
+
+const std::vector<Realization> &ChordGraph::predecessors(int i) const {
+    return vertex_data(i).preds;
+}
+
+int ChordGraph::predecessor_index(int i, const Realization &r) const {
+    const std::map<ivector,int> &index = vertex_data(i).index;
+    std::map<ivector,int>::const_iterator it = index.find(realization_key(r));
+    return it == index.end() ? -1 : it->second;
+}
+
+const ChordGraph::GlueTable &ChordGraph::glue_table(int i, int j) const {
+    glp_arc *a = arc(i, j);
+    assert(a != NULL);
+    arc_cache &ac = _arc_cache.at(a);
+    std::call_once(ac.once, [&]() {
+        Profile::Timer timer("ChordGraph::glue_table");
+        GlueTable &gt = ac.table;
+        const std::set<Transition> &ta = transitions(a);
+        const vertex_cache &src = vertex_data(i), &dest = vertex_data(j);
+        int mc, tcn;
+        ivector f;
+        gt._size = ta.size();
+        for (std::set<Transition>::const_iterator it = ta.begin(); it != ta.end(); ++it) {
+            gt._trans.push_back(&(*it));
+            gt._targets.push_back(dest.index.at(realization_key(it->second())));
+        }
+        gt._entries.resize(src.preds.size() * gt._size);
+        std::vector<GlueTable::entry>::iterator et = gt._entries.begin();
+        for (std::vector<Realization>::const_iterator it = src.preds.begin(); it != src.preds.end(); ++it) {
+            for (int k = 0; k < gt._size; ++k, ++et) {
+                assert(gt._trans[k]->glue(*it, mc, tcn, f, M));
+                et->phi = Transition::sym4_index(f);
+                et->mc = mc;
+                et->tcn = tcn;
+            }
+        }
+    });
+    return ac.table;
+}
+
 int ChordGraph::find_vertex_by_chord(const Chord &c) const {
     for (int i = 1; i <= number_of_vertices(); ++i) {
         if (chord_map.at(i) == c)
@@ -99,15 +198,22 @@ const Chord &ChordGraph::vertex2chord(int i) const {
     return chord_map.at(i);
 }
 
-bool ChordGraph::find_voicing(const std::vector<Chord> &seq, int &z0,
-                              double spread_weight, double vl_weight, double aug_weight, voicing &v, bool best) const {
-    ivector walk;
+bool ChordGraph::find_walk(const std::vector<Chord> &seq, ivector &walk) const {
+    walk.clear();
     for (std::vector<Chord>::const_iterator it = seq.begin(); it != seq.end(); ++it) {
         int v = find_vertex_by_chord(*it);
         if (v == 0 || (it != seq.begin() && arc(walk.back(), v) == NULL))
             return false;
         walk.push_back(v);
     }
+    return true;
+}
+
+bool ChordGraph::find_voicing(const std::vector<Chord> &seq, int &z0,
+                              double spread_weight, double vl_weight, double aug_weight, voicing &v, bool best) const {
+    ivector walk;
+    if (!find_walk(seq, walk))
+        return false;
     std::vector<double> wgh;
     wgh.push_back(spread_weight);
     wgh.push_back(vl_weight);
@@ -116,14 +222,100 @@ bool ChordGraph::find_voicing(const std::vector<Chord> &seq, int &z0,
     return true;
 }
 
+bool ChordGraph::find_voicing_beam(const std::vector<Chord> &seq, int beam, int deadline_ms, int &z0,
+                                   double spread_weight, double vl_weight, double aug_weight,
+                                   voicing &v, double &weight, double &bound) const {
+    ivector walk;
+    if (!find_walk(seq, walk))
+        return false;
+    std::vector<double> wgh;
+    wgh.push_back(spread_weight);
+    wgh.push_back(vl_weight);
+    wgh.push_back(aug_weight);
+    z0 = TransitionNetwork::find_voicing_beam(*this, walk, wgh, beam, deadline_ms, v, weight, bound);
+    return true;
+}
+
+bool ChordGraph::find_voicing_parallel(const std::vector<Chord> &seq, int num_threads, int &z0,
+                                       double spread_weight, double vl_weight, double aug_weight, voicing &v) const {
+    ivector walk;
+    if (!find_walk(seq, walk))
+        return false;
+    std::vector<double> wgh;
+    wgh.push_back(spread_weight);
+    wgh.push_back(vl_weight);
+    wgh.push_back(aug_weight);
+    z0 = TransitionNetwork::find_voicing_parallel(*this, walk, wgh, v, num_threads);
+    return true;
+}
+
+bool ChordGraph::sweep_weights(const std::vector<Chord> &seq, const std::vector<std::vector<double> > &wgh,
+                               std::vector<voicing> &v, std::vector<double> &weight, ivector &z0, ivector &same) const {
+    ivector walk;
+    if (!find_walk(seq, walk))
+        return false;
+    TransitionNetwork::sweep_weights(*this, walk, wgh, v, weight, z0, same);
+    return true;
+}
+
+bool ChordGraph::find_pareto_voicings(const std::vector<Chord> &seq, std::vector<std::pair<std::vector<double>,voicing> > &vs,
+                                      ivector &z0) const {
+    ivector walk;
+    if (!find_walk(seq, walk))
+        return false;
+    vs = TransitionNetwork::find_pareto_voicings(*this, walk, z0);
+    return true;
+}
+
+bool ChordGraph::find_best_voicings(const std::vector<Chord> &seq, int k, double spread_weight, double vl_weight, double aug_weight,
+                                    std::vector<std::pair<double,voicing> > &vs) const {
+    ivector walk;
+    if (!find_walk(seq, walk))
+        return false;
+    std::vector<double> wgh;
+    wgh.push_back(spread_weight);
+    wgh.push_back(vl_weight);
+    wgh.push_back(aug_weight);
+    vs = TransitionNetwork::find_best_voicings(*this, walk, wgh, k);
+    return true;
+}
+
+bool ChordGraph::find_near_optimal_voicings(const std::vector<Chord> &seq, double eps, bool relative,
+                                            double spread_weight, double vl_weight, double aug_weight,
+                                            std::vector<std::pair<double,voicing> > &vs) const {
+    ivector walk;
+    if (!find_walk(seq, walk))
+        return false;
+    std::vector<double> wgh;
+    wgh.push_back(spread_weight);
+    wgh.push_back(vl_weight);
+    wgh.push_back(aug_weight);
+    vs.clear();
+    TransitionNetwork::find_near_optimal_voicings(*this, walk, wgh, eps, relative, [&vs](double w, const voicing &v) {
+        vs.push_back(std::make_pair(w, v));
+        return true;
+    });
+    return true;
+}
+
+bool ChordGraph::count_near_optimal_voicings(const std::vector<Chord> &seq, double eps, bool relative,
+                                             double spread_weight, double vl_weight, double aug_weight,
+                                             unsigned long long &count) const {
+    ivector walk;
+    if (!find_walk(seq, walk))
+        return false;
+    std::vector<double> wgh;
+    wgh.push_back(spread_weight);
+    wgh.push_back(vl_weight);
+    wgh.push_back(aug_weight);
+    count = TransitionNetwork::find_near_optimal_voicings(*this, walk, wgh, eps, relative, NULL);
+    return true;
+}
+
 bool ChordGraph::find_voicings(const std::vector<Chord> &seq, double spread_weight, double vl_weight, double aug_weight, std::set<voicing> &vs) const {
     ivector walk;
-    for (std::vector<Chord>::const_iterator it = seq.begin(); it != seq.end(); ++it) {
-        int v = find_vertex_by_chord(*it);
-        if (v == 0 || (it != seq.begin() && arc(walk.back(), v) == NULL))
-            return false;
-        walk.push_back(v);
-    }
+    if (!find_walk(seq, walk))
+        return false;
     std::vector<double> wgh;
     wgh.push_back(spread_weight);
     wgh.push_back(vl_weight);
@@ -133,18 +325,26 @@ bool ChordGraph::find_voicings(const std::vector<Chord> &seq, double spread_weig
 }
 
 void ChordGraph::shortest_paths(int src, int dest, std::vector<ivector> &paths) {
+    shortest_paths(src, dest, paths, _ws);
+}
+
+void ChordGraph::shortest_paths(int src, int dest, std::vector<ivector> &paths, Workspace &ws) const {
     if (src == dest)
         return;
     int k = 0;
     while (paths.empty()) {
         ++k;
-        enable_all_arcs();
-        enable_all_vertices();
-        yen(src, dest, 0, k, k, paths);
+        ws.enable_all_arcs();
+        ws.enable_all_vertices();
+        yen(src, dest, 0, k, k, paths, ws);
     }
 }
 
 void ChordGraph::all_shortest_paths(pathmap &path_map) {
+    all_shortest_paths(path_map, _ws);
+}
+
+void ChordGraph::all_shortest_paths(pathmap &path_map, Workspace &ws) const {
     int n = number_of_vertices();
     path_map.clear();
     int total_paths = 0, total_length = 0, len;
@@ -153,7 +353,7 @@ void ChordGraph::all_shortest_paths(pathmap &path_map) {
             if (j == k)
                 continue;
             std::vector<ivector> &paths = path_map[std::make_pair(j, k)];
-            shortest_paths(j, k, paths);
+            shortest_paths(j, k, paths, ws);
             total_paths += paths.size();
             for (std::vector<ivector>::const_iterator it = paths.begin(); it != paths.end(); ++it) {
                 len = it->size() - 1;
@@ -235,12 +435,16 @@ double ChordGraph::katz_centrality(int k, bool rev, double q) const {
 }
 
 double ChordGraph::closeness_centrality(int i) {
+    return closeness_centrality(i, _ws);
+}
+
+double ChordGraph::closeness_centrality(int i, Workspace &ws) const {
     int n = number_of_vertices(), d = 0;
     ivector path;
     for (int j = 1; j <= n; ++j) {
         if (i == j)
             continue;
-        bfs(i, j, path);
+        bfs(i, j, path, ws);
         d += path.size() - 1;
     }
     return (double)(n - 1)/(double)d;
@@ -267,7 +471,7 @@ ivector ChordGraph::rand_perm(int n) {
     return p;
 }
 
-void ChordGraph::make_acyclic(const ivector &perm) {
+void ChordGraph::make_acyclic(const ivector &perm, Workspace &ws) const {
     glp_vertex *v;
     glp_arc *a;
     int i, j;
@@ -277,17 +481,21 @@ void ChordGraph::make_acyclic(const ivector &perm) {
         while (a != NULL) {
             j = a->head->i;
             if (perm[i] > perm[j])
-                arc_data(a)->active = false;
+                ws.set_arc_active(a, false);
             a = a->t_next;
         }
     }
 }
 
 void ChordGraph::find_fixed_length_paths(int src, int dest, int len, int limit, std::vector<ivector> &paths) {
+    find_fixed_length_paths(src, dest, len, limit, paths, _ws);
+}
+
+void ChordGraph::find_fixed_length_paths(int src, int dest, int len, int limit, std::vector<ivector> &paths, Workspace &ws) const {
     int nv = number_of_vertices();
     assert(len > 1 && src > 0 && src <= nv && dest > 0 && dest <= nv);
-    enable_all_vertices();
-    enable_all_arcs();
+    ws.enable_all_vertices();
+    ws.enable_all_arcs();
     paths.clear();
     ivector p;
     int i, j, k, pc, s;
@@ -303,14 +511,14 @@ void ChordGraph::find_fixed_length_paths(int src, int dest, int len, int limit,
                     break;
             }
             used_perm.insert(p);
-            make_acyclic(p);
-            Matrix A = adjacency_matrix(), B = A;
+            make_acyclic(p, ws);
+            Matrix A = adjacency_matrix(ws), B = A;
             j = A.element(src, dest);
             for (i = 2; i <= len; ++i) {
                 B.mul(A, src, i == len ? dest : 0);
                 j += B.element(src, dest);
             }
-            enable_all_arcs();
+            ws.enable_all_arcs();
             if ((k = B.element(src, dest)) > 0 && j <= 2.5e5) {
                 p.push_back(k);
                 perm_set.insert(std::make_pair(j / (double)k, p));
@@ -321,15 +529,15 @@ void ChordGraph::find_fixed_length_paths(int src, int dest, int len, int limit,
         if (perm_set.empty()) continue;
         const std::pair<double, ivector> &bp = *perm_set.begin();
         s -= bp.second.back();
-        make_acyclic(bp.second);
+        make_acyclic(bp.second, ws);
         std::vector<ivector> yp;
-        yen(src, dest, 0, len, len, yp);
+        yen(src, dest, 0, len, len, yp, ws);
         for (std::vector<ivector>::const_iterator it = yp.begin(); it != yp.end(); ++it) {
             path_set.insert(*it);
             if ((int)path_set.size() == limit) break;
         }
         perm_set.erase(perm_set.begin());
-        enable_all_arcs();
+        ws.enable_all_arcs();
     }
     for (std::set<ivector, path_comp>::const_iterator it = path_set.begin(); it != path_set.end(); ++it) {
         paths.push_back(*it);
@@ -24,17 +24,63 @@
 #include "transition.h"
 #include "domain.h"
 #include "digraph.h"
+#include <mutex>
 
 typedef std::map<std::pair<int,int>,std::vector<ivector> > pathmap;
 typedef std::vector<std::pair<Realization, bool> > voicing;
 
 class ChordGraph : public Digraph {
 
+public:
+    /* The results of Transition::glue for all transitions on an arc (i,j) and all realizations of the i-th chord
+     * which may precede them (see predecessors). */
+    class GlueTable {
+    public:
+        struct entry {
+            unsigned char phi;      // the voice mapping, given as an index in Transition::sym4
+            unsigned char mc;       // the number of mandatory cues
+            unsigned short tcn;     // the taxicab norm of the voice leading
+        };
+
+    private:
+        friend class ChordGraph;
+        int _size;
+        std::vector<const Transition*> _trans;
+        ivector _targets;
+        std::vector<entry> _entries;
+    public:
+        int size() const;
+        /* returns the number of transitions on the arc */
+
+        const Transition &transition(int k) const;
+        /* returns the k-th transition on the arc, in the order of ChordGraph::transitions */
+
+        int target(int k) const;
+        /* returns the index of the second realization of the k-th transition among the predecessors of the j-th chord */
+
+        const entry *row(int x) const;
+        /* returns the glue data for all transitions on the arc with respect to the x-th predecessor of the i-th chord */
+    };
+
+private:
+    struct vertex_cache {
+        std::once_flag once;
+        std::vector<Realization> preds;
+        std::map<ivector,int> index;
+    };
+    struct arc_cache {
+        std::once_flag once;
+        GlueTable table;
+    };
+
     int M; // class index
     Domain _support;
     bool _allows_aug;
+    PreparationScheme _prep;
     std::map<int,Chord> chord_map;
     std::map<glp_arc*,std::set<Transition> > transition_map;
+    mutable std::map<int,vertex_cache> _vertex_cache;
+    mutable std::map<glp_arc*,arc_cache> _arc_cache;
 
     struct path_comp {
         bool operator ()(const ivector &p, const ivector &q) const {
@@ -46,10 +92,17 @@ class ChordGraph : public Digraph {
 
     static int rand_int(int n);
 
+    static ivector realization_key(const Realization &r);
+
+    const vertex_cache &vertex_data(int i) const;
+
+    bool find_walk(const std::vector<Chord> &seq, ivector &walk) const;
+    /* stores the walk in this graph corresponding to seq in walk, returns false if there is no such walk */
+
     static ivector rand_perm(int n);
 
-    void make_acyclic(const ivector &perm);
-    /* makes this network acyclic by making some arcs inactive */
+    void make_acyclic(const ivector &perm, Workspace &ws) const;
+    /* makes this network acyclic by making some arcs inactive in ws */
 
 public:
     ChordGraph(const std::vector<Chord> &chords, int k, const Domain &sup,
@@ -74,12 +127,27 @@ public:
     bool allows_augmented_sixths() const;
     /* returns true iff augmented-sixth realizations are allowed in this graph */
 
+    PreparationScheme preparation_scheme() const;
+    /* returns the preparation scheme used for the elementary transitions */
+
     const std::set<Transition> &transitions(glp_arc *a) const;
     /* returns the list transitions corresponding to a */
 
     const std::set<Transition> &transitions(int i, int j) const;
     /* returns the list transitions corresponding to the arc (i,j) */
 
+    const std::vector<Realization> &predecessors(int i) const;
+    /* returns the realizations which may precede a transition from the i-th chord in a voicing, i.e. its tonal
+     * realizations in the support (first, in the order of Realization::tonal_realizations), followed by
+     * the second realizations of the transitions entering the i-th vertex
+     *  - the list is computed on first use, this is thread-safe */
+
+    int predecessor_index(int i, const Realization &r) const;
+    /* returns the index of r in predecessors(i), or -1 if it is not there */
+
+    const GlueTable &glue_table(int i, int j) const;
+    /* returns the glue data for the arc (i,j), which is computed on first use (this is thread-safe) */
+
     int find_vertex_by_chord(const Chord &c) const;
     /* returns the index of the vertex corresponding to c, or 0 if no such vertex exists in this graph */
 
@@ -96,18 +164,72 @@ public:
      *  - if best = true, return optimal voicing, else return worst voicing
      */
 
+    bool find_voicing_beam(const std::vector<Chord> &seq, int beam, int deadline_ms, int &z0,
+                           double spread_weight, double vl_weight, double aug_weight,
+                           voicing &v, double &weight, double &bound) const;
+    /* finds a voicing for chord sequence seq within the given time by beam search with the given initial width,
+     * which may not be optimal (see TransitionNetwork::find_voicing_beam)
+     *  - returns true iff prog is a walk in this graph
+     *  - weight is the weight of the voicing and bound is a lower bound on the optimal weight
+     */
+
+    bool find_voicing_parallel(const std::vector<Chord> &seq, int num_threads, int &z0,
+                               double spread_weight, double vl_weight, double aug_weight, voicing &v) const;
+    /* finds an optimal voicing for chord sequence seq using num_threads worker threads, which may differ from
+     * that found by find_voicing if there are several (see TransitionNetwork::find_voicing_parallel)
+     *  - returns true iff prog is a walk in this graph
+     */
+
+    bool sweep_weights(const std::vector<Chord> &seq, const std::vector<std::vector<double> > &wgh,
+                       std::vector<voicing> &v, std::vector<double> &weight, ivector &z0, ivector &same) const;
+    /* finds an optimal voicing for chord sequence seq for each of the weight vectors in wgh
+     * (see TransitionNetwork::sweep_weights)
+     *  - returns true iff prog is a walk in this graph
+     */
+
+    bool find_pareto_voicings(const std::vector<Chord> &seq, std::vector<std::pair<std::vector<double>,voicing> > &vs,
+                              ivector &z0) const;
+    /* finds the Pareto-optimal voicings for chord sequence seq with their components and gravity centers
+     * (see TransitionNetwork::find_pareto_voicings)
+     *  - returns true iff prog is a walk in this graph
+     */
+
+    bool find_best_voicings(const std::vector<Chord> &seq, int k, double spread_weight, double vl_weight, double aug_weight,
+                            std::vector<std::pair<double,voicing> > &vs) const;
+    /* finds the k best voicings for chord sequence seq, ranked by weight and given with their weights
+     *  - returns true iff prog is a walk in this graph
+     */
+
+    bool find_near_optimal_voicings(const std::vector<Chord> &seq, double eps, bool relative,
+                                    double spread_weight, double vl_weight, double aug_weight,
+                                    std::vector<std::pair<double,voicing> > &vs) const;
+    /* finds the voicings for chord sequence seq whose weight is within eps of the optimum (relative to the optimum,
+     * if relative = true), ranked by weight and given with their weights
+     *  - returns true iff prog is a walk in this graph
+     */
+
+    bool count_near_optimal_voicings(const std::vector<Chord> &seq, double eps, bool relative,
+                                     double spread_weight, double vl_weight, double aug_weight,
+                                     unsigned long long &count) const;
+    /* counts the voicings for chord sequence seq whose weight is within eps of the optimum without constructing them
+     *  - returns true iff prog is a walk in this graph
+     */
+
     bool find_voicings(const std::vector<Chord> &seq, double spread_weight, double vl_weight, double aug_weight, std::set<voicing> &vs) const;
     /* finds all optimal voicings for chord sequence seq with respect to the given weight parameters
      *  - returns true iff prog is a walk in this graph
      */
 
     void shortest_paths(int src, int dest, std::vector<ivector> &paths);
+    void shortest_paths(int src, int dest, std::vector<ivector> &paths, Workspace &ws) const;
     /* finds all shortest s-t paths */
 
     void all_shortest_paths(pathmap &path_map);
+    void all_shortest_paths(pathmap &path_map, Workspace &ws) const;
     /* finds all shortest paths and map them with pairs of endpoint vertex indices as keys */
 
     double closeness_centrality(int i);
+    double closeness_centrality(int i, Workspace &ws) const;
     /* computes the closeness centrality for the i-th vertex */
 
     double betweenness_centrality(int i, const pathmap &path_map) const;
@@ -125,6 +247,7 @@ public:
      */
 
     void find_fixed_length_paths(int src, int dest, int len, int limit, std::vector<ivector> &paths);
+    void find_fixed_length_paths(int src, int dest, int len, int limit, std::vector<ivector> &paths, Workspace &ws) const;
     /* finds at most k=limit paths of length len from src to dest */
 };
 
@@ -0,0 +1,247 @@
+/* corpus.cpp
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "corpus.h"
+#include "tone.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static inline bool is_delimiter(char c) {
+    return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r';
+}
+
+Corpus::Corpus() {
+    _data = NULL;
+    _size = 0;
+    _mapped = false;
+    _buffer = NULL;
+    _indexed = false;
+}
+
+Corpus::~Corpus() {
+    close();
+}
+
+void Corpus::close() {
+    if (_mapped)
+        munmap((void*)_data, _size);
+    free(_buffer);
+    _data = _buffer = NULL;
+    _size = 0;
+    _mapped = false;
+    _records.clear();
+    _ids.clear();
+    _start.clear();
+}
+
+bool Corpus::open(const char *filename, bool index_only) {
+    close();
+    _error.clear();
+    int fd = strcmp(filename, "-") == 0 ? STDIN_FILENO : ::open(filename, O_RDONLY);
+    if (fd < 0) {
+        _error = "failed to open file '" + std::string(filename) + "'";
+        return false;
+    }
+    struct stat st;
+    if (fd != STDIN_FILENO && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            _data = (const char*)p;
+            _size = st.st_size;
+            _mapped = true;
+            madvise(p, _size, MADV_SEQUENTIAL);
+        }
+    }
+    if (!_mapped) { // pipes and the like are read into a buffer
+        size_t cap = 0;
+        ssize_t n;
+        while (true) {
+            if (_size == cap) {
+                cap = cap == 0 ? 65536 : 2 * cap;
+                _buffer = (char*)realloc(_buffer, cap);
+                assert(_buffer != NULL);
+            }
+            if ((n = read(fd, _buffer + _size, cap - _size)) <= 0)
+                break;
+            _size += n;
+        }
+        _data = _buffer;
+        if (n < 0) {
+            if (fd != STDIN_FILENO)
+                ::close(fd);
+            _error = "failed to read file '" + std::string(filename) + "'";
+            return false;
+        }
+    }
+    if (fd != STDIN_FILENO)
+        ::close(fd);
+    find_records();
+    _indexed = index_only;
+    if (index_only)
+        return true;
+    _start.reserve(_records.size() + 1);
+    for (std::vector<record>::const_iterator it = _records.begin(); it != _records.end(); ++it) {
+        _start.push_back(_ids.size());
+        if (!parse_record(*it, _ids))
+            return false;
+    }
+    _start.push_back(_ids.size());
+    return true;
+}
+
+/* A record is a maximal group of lines which are not blank, comments excluded. */
+void Corpus::find_records() {
+    const char *p = _data, *end = _data + _size, *eol;
+    bool blank, in_record = false;
+    int line = 0;
+    record rec;
+    for (; p < end; p = eol + 1) {
+        ++line;
+        eol = (const char*)memchr(p, '\n', end - p);
+        if (eol == NULL)
+            eol = end;
+        if (*p == '#')
+            continue;
+        blank = true;
+        for (const char *q = p; q < eol && blank; ++q) {
+            blank = is_delimiter(*q);
+        }
+        if (blank) {
+            if (in_record) {
+                _records.push_back(rec);
+                in_record = false;
+            }
+        } else if (!in_record) {
+            rec.begin = p - _data;
+            rec.line = line;
+            in_record = true;
+        }
+        if (in_record)
+            rec.end = (eol < end ? eol + 1 : eol) - _data;
+    }
+    if (in_record)
+        _records.push_back(rec);
+}
+
+bool Corpus::parse_record(const record &rec, std::vector<unsigned char> &ids) const {
+    const char *p = _data + rec.begin, *end = _data + rec.end, *tok;
+    int line = rec.line, id;
+    bool line_start = true;
+    while (p < end) {
+        if (*p == '\n') {
+            ++line;
+            line_start = true;
+            ++p;
+            continue;
+        }
+        if (line_start && *p == '#') {
+            p = (const char*)memchr(p, '\n', end - p);
+            if (p == NULL)
+                p = end;
+            continue;
+        }
+        line_start = false;
+        if (is_delimiter(*p)) {
+            ++p;
+            continue;
+        }
+        for (tok = p; p < end && *p != '\n' && !is_delimiter(*p); ++p);
+        if ((id = parse_chord(tok, p)) < 0) {
+            _error = "'" + std::string(tok, p - tok) + "' on line " + std::to_string(line) + " is not a chord";
+            return false;
+        }
+        ids.push_back(id);
+    }
+    return true;
+}
+
+int Corpus::size() const {
+    return _records.size();
+}
+
+int Corpus::length(int k) const {
+    assert(!_indexed && k >= 0 && k < size());
+    return _start[k+1] - _start[k];
+}
+
+const unsigned char *Corpus::ids(int k) const {
+    assert(!_indexed && k >= 0 && k < size());
+    return _ids.data() + _start[k];
+}
+
+bool Corpus::sequence(int k, std::vector<Chord> &seq) const {
+    assert(k >= 0 && k < size());
+    seq.clear();
+    if (!_indexed) {
+        for (size_t i = _start[k]; i < _start[k+1]; ++i) {
+            seq.push_back(Chord::from_id(_ids[i]));
+        }
+        return true;
+    }
+    std::vector<unsigned char> ids;
+    if (!parse_record(_records[k], ids))
+        return false;
+    for (std::vector<unsigned char>::const_iterator it = ids.begin(); it != ids.end(); ++it) {
+        seq.push_back(Chord::from_id(*it));
+    }
+    return true;
+}
+
+int Corpus::line(int k) const {
+    assert(k >= 0 && k < size());
+    return _records[k].line;
+}
+
+size_t Corpus::total_chords() const {
+    assert(!_indexed);
+    return _ids.size();
+}
+
+const std::string &Corpus::error() const {
+    return _error;
+}
+
+/* The root is read as atoi would read it, and zero is accepted only if written as "0". */
+int Corpus::parse_chord(const char *begin, const char *end) {
+    const char *colon = (const char*)memchr(begin, ':', end - begin), *p = begin;
+    if (colon == NULL)
+        return -1;
+    bool neg = false;
+    long r = 0;
+    if (p < colon && (*p == '+' || *p == '-'))
+        neg = *(p++) == '-';
+    for (; p < colon && *p >= '0' && *p <= '9' && r < 100000000; ++p) {
+        r = 10 * r + (*p - '0');
+    }
+    int root = Tone::modb(neg ? -r : r, 12);
+    if (root == 0 && (colon - begin != 1 || *begin != '0'))
+        return -1;
+    size_t len = end - colon - 1;
+    for (int t = 0; t < 5; ++t) {
+        if (strlen(Chord::symbols[t]) == len && strncmp(colon + 1, Chord::symbols[t], len) == 0)
+            return t == DIMINISHED_SEVENTH ? 48 + root % 3 : 12 * t + root;
+    }
+    return -1;
+}
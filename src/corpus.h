@@ -0,0 +1,97 @@
+/* corpus.h
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include "chord.h"
+#include <stddef.h>
+
+/* A file of chord sequences, mapped into memory and tokenized in place.
+ *  - chord symbols are separated by spaces, tabs, commas, semicolons or newlines
+ *  - lines starting with # are comments
+ *  - sequences are separated by blank lines (a file without blank lines holds a single sequence)
+ */
+class Corpus {
+
+    struct record {
+        size_t begin;       // byte offset of the first line
+        size_t end;         // byte offset past the last line
+        int line;           // number of the first line (1-based)
+    };
+
+    const char *_data;
+    size_t _size;
+    bool _mapped;
+    char *_buffer;
+    bool _indexed;
+    std::vector<record> _records;
+    std::vector<unsigned char> _ids;   // chord ids of all sequences, one after another
+    std::vector<size_t> _start;        // position of each sequence in _ids (with the total length appended)
+    mutable std::string _error;
+
+    Corpus(const Corpus &other);
+    Corpus &operator =(const Corpus &other);
+
+    void close();
+    void find_records();
+    bool parse_record(const record &rec, std::vector<unsigned char> &ids) const;
+
+public:
+    Corpus();
+    /* creates an empty corpus */
+
+    ~Corpus();
+    /* unmaps the file, if any */
+
+    bool open(const char *filename, bool index_only = false);
+    /* maps the given file into memory and parses it (filename '-' stands for the standard input, which is read)
+     *  - if index_only = true, only the positions of the sequences are recorded and each sequence is parsed
+     *    when requested
+     *  - returns false if the file cannot be read or contains an invalid chord symbol (see error)
+     */
+
+    int size() const;
+    /* returns the number of sequences */
+
+    int length(int k) const;
+    /* returns the number of chords in the k-th sequence (the corpus must not be opened with index_only = true) */
+
+    const unsigned char *ids(int k) const;
+    /* returns the chord ids (see Chord::id) of the k-th sequence (the corpus must not be opened with index_only = true) */
+
+    bool sequence(int k, std::vector<Chord> &seq) const;
+    /* stores the k-th sequence in seq, returns false if it contains an invalid chord symbol (see error) */
+
+    int line(int k) const;
+    /* returns the line on which the k-th sequence starts */
+
+    size_t total_chords() const;
+    /* returns the number of chords in all sequences (the corpus must not be opened with index_only = true) */
+
+    const std::string &error() const;
+    /* returns the description of the last parsing error */
+
+    static int parse_chord(const char *begin, const char *end);
+    /* parses the chord symbol in [begin,end), returns the chord id or -1 if the symbol is not valid
+     *  (a symbol is accepted iff the constructor Chord(const char*) accepts it) */
+};
+
+#endif // CORPUS_H
@@ -0,0 +1,248 @@
+/* corpusstatistics.cpp
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "corpusstatistics.h"
+#include "transitionnetwork.h"
+#include "profile.h"
+#include <assert.h>
+#include <thread>
+#include <atomic>
+
+/* Transition::operator < ignores the order of voices, which is compared last. */
+static bool precedes(const Transition &t1, const Transition &t2) {
+    if (t1 < t2)
+        return true;
+    if (t2 < t1)
+        return false;
+    for (int i = 0; i < 8; ++i) {
+        const Realization &r1 = i < 4 ? t1.first() : t1.second(), &r2 = i < 4 ? t2.first() : t2.second();
+        if (r1.tone(i % 4).lof_position() != r2.tone(i % 4).lof_position())
+            return r1.tone(i % 4).lof_position() < r2.tone(i % 4).lof_position();
+    }
+    return false;
+}
+
+CorpusStatistics::CorpusStatistics() {
+    _sequences = _failed = _chords = _cues = _augmented = _augmented_sequences = 0;
+}
+
+/* A cue is the respelling of the preceding realization, hence the transition to a chord
+ * starts at the cue, if there is one. */
+void CorpusStatistics::add(const voicing &v, int z0) {
+    assert(!v.empty());
+    bool has_aug = false;
+    ++_sequences;
+    ++_key_signatures[z0];
+    for (voicing::const_iterator it = v.begin(); it != v.end(); ++it) {
+        if (it->second) {
+            ++_cues;
+            continue;
+        }
+        ++_chords;
+        if (it->first.is_augmented_sixth()) {
+            ++_augmented;
+            has_aug = true;
+        }
+        if (it == v.begin())
+            continue;
+        Transition t((it - 1)->first, it->first);
+        _trans.add(t);
+        std::pair<int,Transition> &type = _types[TransitionStatistics::canonical_key(t)];
+        if (type.first++ == 0 || precedes(t, type.second))
+            type.second = t;
+    }
+    if (has_aug)
+        ++_augmented_sequences;
+}
+
+void CorpusStatistics::add_failure() {
+    ++_failed;
+}
+
+void CorpusStatistics::merge(const CorpusStatistics &other) {
+    _sequences += other._sequences;
+    _failed += other._failed;
+    _chords += other._chords;
+    _cues += other._cues;
+    _augmented += other._augmented;
+    _augmented_sequences += other._augmented_sequences;
+    _trans.merge(other._trans);
+    for (std::map<ivector,std::pair<int,Transition> >::const_iterator it = other._types.begin(); it != other._types.end(); ++it) {
+        std::pair<int,Transition> &type = _types[it->first];
+        if (type.first == 0 || precedes(it->second.second, type.second))
+            type.second = it->second.second;
+        type.first += it->second.first;
+    }
+    for (std::map<int,int>::const_iterator it = other._key_signatures.begin(); it != other._key_signatures.end(); ++it) {
+        _key_signatures[it->first] += it->second;
+    }
+}
+
+int CorpusStatistics::sequences() const {
+    return _sequences;
+}
+
+int CorpusStatistics::failed() const {
+    return _failed;
+}
+
+int CorpusStatistics::chords() const {
+    return _chords;
+}
+
+int CorpusStatistics::cues() const {
+    return _cues;
+}
+
+int CorpusStatistics::augmented() const {
+    return _augmented;
+}
+
+int CorpusStatistics::augmented_sequences() const {
+    return _augmented_sequences;
+}
+
+const TransitionStatistics &CorpusStatistics::transitions() const {
+    return _trans;
+}
+
+const std::map<ivector,std::pair<int,Transition> > &CorpusStatistics::transition_types() const {
+    return _types;
+}
+
+const std::map<int,int> &CorpusStatistics::key_signatures() const {
+    return _key_signatures;
+}
+
+/* Each transition type is written as [count, c1, t1, t2, t3, t4, c2, t5, t6, t7, t8], where c1 and c2
+ * are the chord ids of the representative and t1, ..., t8 are the lof positions of its voices. */
+void CorpusStatistics::write_json(std::ostream &os) const {
+    os << "{\"type\":\"corpus-statistics\",\"version\":1"
+       << ",\"sequences\":" << _sequences << ",\"failed\":" << _failed << ",\"chords\":" << _chords
+       << ",\"cues\":" << _cues << ",\"augmented\":" << _augmented
+       << ",\"augmented_sequences\":" << _augmented_sequences << ",\"key_signatures\":[";
+    for (std::map<int,int>::const_iterator it = _key_signatures.begin(); it != _key_signatures.end(); ++it) {
+        os << (it == _key_signatures.begin() ? "" : ",") << "[" << it->first << "," << it->second << "]";
+    }
+    os << "],\"transitions\":";
+    _trans.write_json(os);
+    os << ",\"types\":[";
+    for (std::map<ivector,std::pair<int,Transition> >::const_iterator it = _types.begin(); it != _types.end(); ++it) {
+        os << (it == _types.begin() ? "" : ",") << "[" << it->second.first;
+        for (int i = 0; i < 2; ++i) {
+            const Realization &r = i == 0 ? it->second.second.first() : it->second.second.second();
+            os << "," << r.chord().id();
+            for (int j = 0; j < 4; ++j) {
+                os << "," << r.tone(j).lof_position();
+            }
+        }
+        os << "]";
+    }
+    os << "]}";
+}
+
+bool CorpusStatistics::read_json(const JsonValue &v) {
+    *this = CorpusStatistics();
+    if (!v.has("type") || v["type"].kind() != JsonValue::JSON_STRING || v["type"].string() != "corpus-statistics")
+        return false;
+    int version;
+    if (!v.get("version", version) || version != 1 || !v.get("sequences", _sequences) || !v.get("failed", _failed) ||
+            !v.get("chords", _chords) || !v.get("cues", _cues) || !v.get("augmented", _augmented) ||
+            !v.get("augmented_sequences", _augmented_sequences) || !v.has("transitions") ||
+            !_trans.read_json(v["transitions"]) || !v.has("key_signatures") || !v.has("types"))
+        return false;
+    const JsonValue &ks = v["key_signatures"], &types = v["types"];
+    if (ks.kind() != JsonValue::JSON_ARRAY || types.kind() != JsonValue::JSON_ARRAY)
+        return false;
+    for (int i = 0; i < ks.size(); ++i) {
+        if (!ks[i].is_integer_array(2))
+            return false;
+        _key_signatures[ks[i][0].integer()] += ks[i][1].integer();
+    }
+    for (int i = 0; i < types.size(); ++i) {
+        const JsonValue &e = types[i];
+        if (!e.is_integer_array(11) || e[0].integer() <= 0)
+            return false;
+        Realization r[2];
+        for (int k = 0; k < 2; ++k) {
+            int id = e[1+5*k].integer();
+            if (id < 0 || id >= 51)
+                return false;
+            r[k] = Realization(Chord::from_id(id));
+            for (int j = 0; j < 4; ++j) {
+                r[k].tone(j) = Tone(e[2+5*k+j].integer());
+            }
+        }
+        Transition t(r[0], r[1]);
+        std::pair<int,Transition> &type = _types[TransitionStatistics::canonical_key(t)];
+        if (type.first == 0 || precedes(t, type.second))
+            type.second = t;
+        type.first += e[0].integer();
+    }
+    return true;
+}
+
+CorpusStatistics CorpusStatistics::compute(const std::vector<std::vector<Chord> > &seqs, int num_threads,
+                                           const std::function<bool(const std::vector<Chord>&,int&,voicing&)> &voice) {
+    if (num_threads <= 0)
+        num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    /* the sequences are taken from a shared counter, so that idle workers pick up the remaining ones;
+     * all accumulators are integers (the representatives of transition types are minima), hence merging
+     * the partial aggregates gives the same result for any distribution of work */
+    std::vector<CorpusStatistics> partial(num_threads);
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; ++t) {
+        workers.push_back(std::thread([&,t]() {
+            int i, z0;
+            voicing v;
+            while ((i = next++) < (int)seqs.size()) {
+                v.clear();
+                if (!seqs[i].empty() && voice(seqs[i], z0, v))
+                    partial[t].add(v, z0);
+                else partial[t].add_failure();
+            }
+        }));
+    }
+    CorpusStatistics ret;
+    for (int t = 0; t < num_threads; ++t) {
+        workers[t].join();
+        ret.merge(partial[t]);
+    }
+    return ret;
+}
+
+CorpusStatistics CorpusStatistics::compute(const ChordGraph &cg, const std::vector<std::vector<Chord> > &seqs,
+                                           const std::vector<double> &wgh, int num_threads) {
+    Profile::Timer timer("CorpusStatistics::compute");
+    assert(wgh.size() == 3);
+    return compute(seqs, num_threads, [&](const std::vector<Chord> &seq, int &z0, voicing &v) {
+        return cg.find_voicing(seq, z0, wgh[0], wgh[1], wgh[2], v);
+    });
+}
+
+CorpusStatistics CorpusStatistics::compute(const RealizationGraph &rg, const std::vector<std::vector<Chord> > &seqs,
+                                           const std::vector<double> &wgh, int num_threads) {
+    Profile::Timer timer("CorpusStatistics::compute");
+    assert(wgh.size() == 3);
+    return compute(seqs, num_threads, [&](const std::vector<Chord> &seq, int &z0, voicing &v) {
+        return rg.find_voicing(seq, z0, wgh[0], wgh[1], wgh[2], v);
+    });
+}
@@ -0,0 +1,103 @@
+/* corpusstatistics.h
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CORPUSSTATISTICS_H
+#define CORPUSSTATISTICS_H
+
+#include "chordgraph.h"
+#include "realizationgraph.h"
+#include "transitionstatistics.h"
+#include <functional>
+
+class CorpusStatistics {
+
+    int _sequences;
+    int _failed;
+    int _chords;
+    int _cues;
+    int _augmented;
+    int _augmented_sequences;
+    TransitionStatistics _trans;
+    std::map<ivector,std::pair<int,Transition> > _types; // count and representative, keyed by congruence class
+    std::map<int,int> _key_signatures;
+
+    static CorpusStatistics compute(const std::vector<std::vector<Chord> > &seqs, int num_threads,
+                                    const std::function<bool(const std::vector<Chord>&,int&,voicing&)> &voice);
+
+public:
+    CorpusStatistics();
+
+    void add(const voicing &v, int z0);
+    /* accumulates the data of voicing v with gravity center z0 (as returned by ChordGraph::find_voicing) */
+
+    void add_failure();
+    /* counts a sequence which could not be voiced */
+
+    void merge(const CorpusStatistics &other);
+    /* adds the data accumulated in other to this */
+
+    int sequences() const;
+    /* returns the number of voiced sequences */
+
+    int failed() const;
+    /* returns the number of sequences which could not be voiced */
+
+    int chords() const;
+    /* returns the number of chords in voiced sequences */
+
+    int cues() const;
+    /* returns the number of enharmonic cues in the voicings */
+
+    int augmented() const;
+    /* returns the number of chords realized as augmented sixths */
+
+    int augmented_sequences() const;
+    /* returns the number of voicings containing at least one augmented sixth */
+
+    const TransitionStatistics &transitions() const;
+    /* returns the statistics of the transitions chosen by the voicings */
+
+    const std::map<ivector,std::pair<int,Transition> > &transition_types() const;
+    /* returns the frequencies of the chosen transitions up to congruence, keyed by TransitionStatistics::canonical_key
+     * (each class is represented by its least member with respect to Transition::operator <,
+     * ties are broken by comparing the voices) */
+
+    const std::map<int,int> &key_signatures() const;
+    /* returns the distribution of recommended key signatures (positive for sharps, negative for flats) */
+
+    void write_json(std::ostream &os) const;
+    /* writes a snapshot of the accumulated data to os as a JSON object */
+
+    bool read_json(const JsonValue &v);
+    /* replaces the data in this with the snapshot v (as written by write_json), returns false if v is malformed */
+
+    static CorpusStatistics compute(const ChordGraph &cg, const std::vector<std::vector<Chord> > &seqs,
+                                    const std::vector<double> &wgh, int num_threads = 0);
+    /* voices the sequences seqs in cg with weights wgh and returns the accumulated statistics
+     *  - num_threads is the number of worker threads (if 0, use all hardware threads);
+     *    the result does not depend on it
+     */
+
+    static CorpusStatistics compute(const RealizationGraph &rg, const std::vector<std::vector<Chord> > &seqs,
+                                    const std::vector<double> &wgh, int num_threads = 0);
+    /* voices the sequences seqs using the precompiled graph rg, the result is the same as with its chord graph */
+};
+
+#endif // CORPUSSTATISTICS_H
@@ -19,6 +19,7 @@
  */
 
 #include "digraph.h"
+#include "profile.h"
 #include <assert.h>
 #include <algorithm>
 #include <set>
@@ -27,17 +28,93 @@
 #include <float.h>
 #include <string.h>
 
-#define vdata(v) ((v_data*)(v->data))
 #define adata(a) ((a_data*)(a->data))
 #define rdata(a) ((r_data*)(a->data))
 
+Digraph::Workspace::Workspace() {
+    _vertex_epoch = _arc_epoch = _visit_epoch = 1;
+    _vertex_default = _arc_default = true;
+    fit(0, 0);
+}
+
+Digraph::Workspace::Workspace(const Digraph &G) {
+    _vertex_epoch = _arc_epoch = _visit_epoch = 1;
+    _vertex_default = _arc_default = true;
+    fit(G.number_of_vertices(), G._arcs.size());
+}
+
+/* Entries added here get zero stamps, hence they take the default state (and are unvisited). */
+void Digraph::Workspace::fit(int nv, int na) {
+    if ((int)_vertex_stamp.size() != nv + 1) {
+        _vertex_stamp.resize(nv + 1, 0);
+        _vertex_value.resize(nv + 1, true);
+        _reached.resize(nv + 1, 0);
+        _settled.resize(nv + 1, 0);
+        _parent.resize(nv + 1, 0);
+        _dist.resize(nv + 1, DBL_MAX);
+    }
+    if ((int)_arc_stamp.size() != na) {
+        _arc_stamp.resize(na, 0);
+        _arc_value.resize(na, true);
+    }
+}
+
+bool Digraph::Workspace::fits(int nv, int na) const {
+    return (int)_vertex_stamp.size() == nv + 1 && (int)_arc_stamp.size() == na;
+}
+
+void Digraph::Workspace::new_visit() {
+    if (++_visit_epoch == 0) {
+        _reached.assign(_reached.size(), 0);
+        _settled.assign(_settled.size(), 0);
+        _visit_epoch = 1;
+    }
+}
+
+void Digraph::Workspace::enable_all_vertices(bool yes) {
+    if (++_vertex_epoch == 0) {
+        _vertex_stamp.assign(_vertex_stamp.size(), 0);
+        _vertex_epoch = 1;
+    }
+    _vertex_default = yes;
+}
+
+void Digraph::Workspace::enable_all_arcs(bool yes) {
+    if (++_arc_epoch == 0) {
+        _arc_stamp.assign(_arc_stamp.size(), 0);
+        _arc_epoch = 1;
+    }
+    _arc_default = yes;
+}
+
+void Digraph::Workspace::set_vertex_active(int i, bool yes) {
+    assert(i > 0 && i < (int)_vertex_stamp.size());
+    _vertex_stamp[i] = _vertex_epoch;
+    _vertex_value[i] = yes;
+}
+
+void Digraph::Workspace::set_arc_active(glp_arc *a, bool yes) {
+    assert(a != NULL && adata(a)->id < (int)_arc_stamp.size());
+    _arc_stamp[adata(a)->id] = _arc_epoch;
+    _arc_value[adata(a)->id] = yes;
+}
+
+bool Digraph::Workspace::is_vertex_active(int i) const {
+    assert(i > 0 && i < (int)_vertex_stamp.size());
+    return vertex_on(i);
+}
+
+bool Digraph::Workspace::is_arc_active(glp_arc *a) const {
+    assert(a != NULL && adata(a)->id < (int)_arc_stamp.size());
+    return arc_on(adata(a)->id);
+}
+
 Digraph::Digraph(bool is_weighted, bool dot_tex) {
     _is_weighted = is_weighted;
     _dot_tex = dot_tex;
-    assert(sizeof(v_data) <= 256 && sizeof(a_data) <= 256);
-    G = glp_create_graph(sizeof(v_data), sizeof(a_data));
+    assert(sizeof(a_data) <= 256);
+    G = glp_create_graph(0, sizeof(a_data));
     glp_create_v_index(G);
-    P = NULL;
     _num_arcs = 0;
 }
 
@@ -62,6 +139,7 @@ int Digraph::add_vertices(int n) {
     for (int i = vi; i < vi + n; ++i) {
         _vlabels[i] = std::to_string(i);
     }
+    _ws.fit(G->nv, _arcs.size());
     return vi;
 }
 
@@ -78,19 +156,16 @@ glp_vertex *Digraph::vertex(int i) const {
     return G->v[i];
 }
 
-Digraph::v_data *Digraph::vertex_data(int i) const {
-    assert(i > 0 || i <= G->nv);
-    return vdata(G->v[i]);
-}
-
 glp_arc *Digraph::add_arc(int i, int j, double w) {
     glp_arc *a = arc(i, j);
     if (a != NULL)
         return a;
     a = glp_add_arc(G, i, j);
+    adata(a)->id = _arcs.size();
     adata(a)->weight = w;
     ++_num_arcs;
     _arcs.push_back(a);
+    _ws.fit(G->nv, _arcs.size());
     return a;
 }
 
@@ -132,37 +207,49 @@ void Digraph::negate_weights() const {
 }
 
 int Digraph::in_degree(int i) const {
+    return in_degree(i, _ws);
+}
+
+int Digraph::in_degree(int i, const Workspace &ws) const {
+    assert(ws.fits(G->nv, _arcs.size()));
     glp_vertex *v = G->v[i];
     glp_arc *a = v->in;
     int ret = 0;
     while (a != NULL) {
-        if (adata(a)->active) ++ret;
+        if (ws.arc_on(adata(a)->id)) ++ret;
         a = a->h_next;
     }
     return ret;
 }
 
 int Digraph::out_degree(int i) const {
+    return out_degree(i, _ws);
+}
+
+int Digraph::out_degree(int i, const Workspace &ws) const {
+    assert(ws.fits(G->nv, _arcs.size()));
     glp_vertex *v = G->v[i];
     glp_arc *a = v->out;
     int ret = 0;
     while (a != NULL) {
-        if (adata(a)->active) ++ret;
+        if (ws.arc_on(adata(a)->id)) ++ret;
         a = a->t_next;
     }
     return ret;
 }
 
 bool Digraph::bfs(int src, int dest, ivector &path) {
+    return bfs(src, dest, path, _ws);
+}
+
+bool Digraph::bfs(int src, int dest, ivector &path, Workspace &ws) const {
+    ws.fit(G->nv, _arcs.size());
     assert(src > 0 && src <= G->nv && dest > 0 && dest <= G->nv &&
-           vdata(G->v[src])->active && vdata(G->v[dest])->active);
-    for (int i = 1; i <= G->nv; ++i) {
-        vdata(G->v[i])->discovered = false;
-        vdata(G->v[i])->parent = 0;
-    }
+           ws.vertex_on(src) && ws.vertex_on(dest));
+    ws.new_visit();
     std::queue<int> Q;
     Q.push(src);
-    vdata(G->v[src])->discovered = true;
+    ws.reach(src, 0, 0);
     glp_vertex *v, *w;
     glp_arc *a;
     while (!Q.empty()) {
@@ -173,19 +260,18 @@ bool Digraph::bfs(int src, int dest, ivector &path) {
             int i = v->i;
             while (i != 0) {
                 path.push_back(i);
-                i = vdata(G->v[i])->parent;
+                i = ws.parent(i);
             }
             std::reverse(path.begin(), path.end());
             return true;
         }
         a = v->out;
         while (a != NULL) {
-            if (adata(a)->active) {
+            if (ws.arc_on(adata(a)->id)) {
                 w = a->head;
-                if (vdata(w)->active && !vdata(w)->discovered) {
+                if (ws.vertex_on(w->i) && !ws.reached(w->i)) {
                     Q.push(w->i);
-                    vdata(w)->discovered = true;
-                    vdata(w)->parent = v->i;
+                    ws.reach(w->i, v->i, 0);
                 }
             }
             a = a->t_next;
@@ -194,7 +280,7 @@ bool Digraph::bfs(int src, int dest, ivector &path) {
     return false;
 }
 
-glp_vertex *Digraph::store_path(const ivector &path, glp_vertex *root) {
+glp_vertex *Digraph::store_path(glp_graph *P, const ivector &path, glp_vertex *root) {
     glp_vertex *v = root;
     glp_arc *a;
     int i, j, n = path.size();
@@ -240,8 +326,15 @@ void Digraph::restore_path(glp_vertex *top, int src, ivector &path) {
 }
 
 void Digraph::yen(int src, int dest, int K, double lb, double ub, std::vector<ivector> &paths) {
+    yen(src, dest, K, lb, ub, paths, _ws);
+}
+
+void Digraph::yen(int src, int dest, int K, double lb, double ub, std::vector<ivector> &paths, Workspace &ws) const {
     assert(lb <= ub && sizeof(r_data) <= 256);
-    P = glp_create_graph(0, sizeof(r_data));
+    Profile::Timer timer("Digraph::yen");
+    Profile::count(PROFILE_YEN_CALLS);
+    /* the prefix tree of the paths found so far */
+    glp_graph *P = glp_create_graph(0, sizeof(r_data));
     std::set<std::pair<double, glp_vertex*> > candidates;
     std::set<std::pair<double, glp_vertex*> >::const_iterator cit;
     std::vector<glp_vertex*> final;
@@ -256,17 +349,19 @@ void Digraph::yen(int src, int dest, int K, double lb, double ub, std::vector<iv
     bool has_path;
     double pw, spw;
     if (_is_weighted) {
-        dijkstra(src, dest);
-        if ((has_path = get_path(dest, path)))
+        dijkstra(src, dest, ws);
+        if ((has_path = get_path(dest, path, ws)))
             pw = path_weight(path);
     } else {
-        if ((has_path = bfs(src, dest, path)))
+        if ((has_path = bfs(src, dest, path, ws)))
             pw = path.size();
     }
-    if (!has_path || (ub > 0 && pw > ub))
+    if (!has_path || (ub > 0 && pw > ub)) {
+        glp_delete_graph(P);
         return;
+    }
     glp_add_vertices(P, 1);
-    bp = store_path(path, P->v[1]);
+    bp = store_path(P, path, P->v[1]);
     select_path(bp);
     if (pw >= lb) final.push_back(bp);
     while (K == 0 || (int)final.size() < K) {
@@ -279,8 +374,10 @@ void Digraph::yen(int src, int dest, int K, double lb, double ub, std::vector<iv
                 if (rdata(a)->selected) {
                     j = rdata(a)->i;
                     b = arc(spur_node, j);
-                    inactive_arcs.push(b);
-                    adata(b)->active = false;
+                    if (ws.is_arc_active(b)) {
+                        inactive_arcs.push(b);
+                        ws.set_arc_active(b, false);
+                    }
                     if (j == path[i+1])
                         v = a->head;
                 }
@@ -288,23 +385,23 @@ void Digraph::yen(int src, int dest, int K, double lb, double ub, std::vector<iv
             }
             if (_is_weighted) {
                 pw = path_weight(ivector(path.begin(), path.begin() + i + 1));
-                dijkstra(spur_node, dest);
-                if ((has_path = get_path(dest, spur_path)))
+                dijkstra(spur_node, dest, ws);
+                if ((has_path = get_path(dest, spur_path, ws)))
                     spw = path_weight(spur_path);
             } else {
                 pw = i;
-                if ((has_path = bfs(spur_node, dest, spur_path)))
+                if ((has_path = bfs(spur_node, dest, spur_path, ws)))
                     spw = spur_path.size();
             }
             if (has_path)
-                candidates.insert(std::make_pair(pw + spw, store_path(spur_path, v->in->tail)));
-            vdata(G->v[spur_node])->active = false;
+                candidates.insert(std::make_pair(pw + spw, store_path(P, spur_path, v->in->tail)));
+            ws.set_vertex_active(spur_node, false);
         }
         for (ivector::const_iterator it = path.begin(); it + 1 != path.end(); ++it) {
-            vdata(G->v[*it])->active = true;
+            ws.set_vertex_active(*it, true);
         }
         while (!inactive_arcs.empty()) {
-            adata(inactive_arcs.top())->active = true;
+            ws.set_arc_active(inactive_arcs.top(), true);
             inactive_arcs.pop();
         }
         if (candidates.empty()) break;
@@ -322,92 +419,94 @@ void Digraph::yen(int src, int dest, int K, double lb, double ub, std::vector<iv
     glp_delete_graph(P);
 }
 
-void Digraph::dijkstra(int src, int dest) const {
+void Digraph::dijkstra(int src, int dest) {
+    dijkstra(src, dest, _ws);
+}
+
+/* The queue is a binary heap of pairs (distance, index) with lazy deletion, so that among the vertices
+ * at the same distance the one with the smallest index is settled first. */
+void Digraph::dijkstra(int src, int dest, Workspace &ws) const {
+    ws.fit(G->nv, _arcs.size());
     assert(src > 0 && src <= G->nv && (dest == 0 || (dest > 0 && dest <= G->nv)));
-    assert(vdata(G->v[src])->active && (dest == 0 || vdata(G->v[dest])->active));
-    int i;
-    ivector Q;
-    ivector::const_iterator it, it_min;
-    Q.reserve(G->nv);
-    std::vector<bool> popped(G->nv+1, false);
+    assert(ws.vertex_on(src) && (dest == 0 || ws.vertex_on(dest)));
+    int nrelax = 0;
+    std::priority_queue<std::pair<double,int>, std::vector<std::pair<double,int> >,
+                        std::greater<std::pair<double,int> > > Q;
     glp_vertex *u, *v;
     glp_arc *a;
-    double mindist, alt, d;
-    for (i = 1; i <= G->nv; ++i) {
-        v = G->v[i];
-        if (!vdata(v)->active)
-            continue;
-        vdata(v)->dist = i == src ? 0 : DBL_MAX;
-        vdata(v)->parent = 0;
-        Q.push_back(i);
-    }
+    double alt;
+    ws.new_visit();
+    ws.reach(src, 0, 0);
+    Q.push(std::make_pair(0.0, src));
     while (!Q.empty()) {
-        u = NULL;
-        it_min = Q.end();
-        mindist = DBL_MAX;
-        for (it = Q.begin(); it != Q.end(); ++it) {
-            d = vdata(G->v[*it])->dist;
-            if (d < mindist) {
-                u = G->v[*it];
-                mindist = d;
-                it_min = it;
-            }
+        u = G->v[Q.top().second];
+        if (ws.settled(u->i) || Q.top().first > ws.dist(u->i)) {
+            Q.pop();
+            continue;
         }
-        if (it_min == Q.end() || u->i == dest)
+        if (u->i == dest)
             break;
-        Q.erase(it_min);
-        popped[u->i] = true;
+        Q.pop();
+        ws.settle(u->i);
         a = u->out;
         while (a != NULL) {
-            if (adata(a)->active) {
+            if (ws.arc_on(adata(a)->id)) {
                 v = a->head;
-                if (vdata(v)->active && !popped[v->i]) {
-                    alt = vdata(u)->dist + adata(a)->weight;
-                    if (alt < vdata(v)->dist) {
-                        vdata(v)->dist = alt;
-                        vdata(v)->parent = u->i;
+                if (ws.vertex_on(v->i) && !ws.settled(v->i)) {
+                    ++nrelax;
+                    alt = ws.dist(u->i) + adata(a)->weight;
+                    if (alt < ws.dist(v->i)) {
+                        ws.reach(v->i, u->i, alt);
+                        Q.push(std::make_pair(alt, v->i));
                     }
                 }
             }
             a = a->t_next;
         }
     }
+    Profile::count(PROFILE_DIJKSTRA_CALLS);
+    Profile::count(PROFILE_RELAXATIONS, nrelax);
 }
 
-void Digraph::bellman_ford(int src) const {
+void Digraph::bellman_ford(int src) {
+    bellman_ford(src, _ws);
+}
+
+void Digraph::bellman_ford(int src, Workspace &ws) const {
+    ws.fit(G->nv, _arcs.size());
     int n = G->nv, i;
     glp_vertex *u, *v;
     glp_arc *a;
     double w;
-    for (i = 1; i <= n; ++i) {
-        v = G->v[i];
-        if (!vdata(v)->active)
-            continue;
-        vdata(v)->dist = i == src ? 0 : DBL_MAX;
-        vdata(v)->parent = 0;
-    }
+    ws.new_visit();
+    if (ws.vertex_on(src))
+        ws.reach(src, 0, 0);
+    Profile::count(PROFILE_RELAXATIONS, (long long)(n - 1) * _arcs.size());
     for (i = 1; i < n; ++i) {
         for (std::vector<glp_arc*>::const_iterator it = _arcs.begin(); it != _arcs.end(); ++it) {
             a = *it;
             u = a->tail;
             v = a->head;
             w = adata(a)->weight;
-            if (vdata(u)->dist + w < vdata(v)->dist) {
-                vdata(v)->dist = vdata(u)->dist + w;
-                vdata(v)->parent = u->i;
-            }
+            if (ws.dist(u->i) + w < ws.dist(v->i))
+                ws.reach(v->i, u->i, ws.dist(u->i) + w);
         }
     }
 }
 
 bool Digraph::get_path(int dest, ivector &path) const {
-    if (vdata(G->v[dest])->parent == 0)
+    return get_path(dest, path, _ws);
+}
+
+bool Digraph::get_path(int dest, ivector &path, const Workspace &ws) const {
+    assert(ws.fits(G->nv, _arcs.size()));
+    if (ws.parent(dest) == 0)
         return false;
     int i = dest;
     path.clear();
     while(i > 0) {
         path.push_back(i);
-        i = vdata(G->v[i])->parent;
+        i = ws.parent(i);
     }
     std::reverse(path.begin(), path.end());
     return true;
@@ -423,25 +522,19 @@ double Digraph::path_weight(const ivector &path) const {
 }
 
 void Digraph::enable_all_vertices(bool yes) {
-    for (int i = 1; i <= G->nv; ++i) {
-        vdata(G->v[i])->active = yes;
-    }
+    _ws.enable_all_vertices(yes);
 }
 
 void Digraph::enable_all_arcs(bool yes) {
-    glp_vertex *v;
-    glp_arc *a;
-    for (int i = 1; i <= G->nv; ++i) {
-        v = G->v[i];
-        a = v->out;
-        while (a != NULL) {
-            adata(a)->active = yes;
-            a = a->t_next;
-        }
-    }
+    _ws.enable_all_arcs(yes);
 }
 
 Matrix Digraph::adjacency_matrix() const {
+    return adjacency_matrix(_ws);
+}
+
+Matrix Digraph::adjacency_matrix(const Workspace &ws) const {
+    assert(ws.fits(G->nv, _arcs.size()));
     Matrix ret(G->nv);
     glp_vertex *v;
     glp_arc *a;
@@ -449,7 +542,7 @@ Matrix Digraph::adjacency_matrix() const {
         v = G->v[i];
         a = v->out;
         while (a != NULL) {
-            if (adata(a)->active)
+            if (ws.arc_on(adata(a)->id))
                 ret.set_element(i, a->head->i, 1.0);
             a = a->t_next;
         }
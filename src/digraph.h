@@ -28,21 +28,64 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <float.h>
 
 typedef std::vector<int> ivector;
 
 class Digraph {
 
-private:
-    typedef struct {
-        bool active;
-        int parent;
-        bool discovered;
-        double dist;
-    } v_data;
+public:
+    class Workspace {
+        friend class Digraph;
+        /* Activation flags and search marks are stamped with generation counters: an entry is valid only
+         * if its stamp equals the current generation, so that a reset is a single increment and a query
+         * touches only the vertices which it actually reaches. */
+        unsigned _vertex_epoch, _arc_epoch, _visit_epoch;
+        bool _vertex_default, _arc_default;
+        std::vector<unsigned> _vertex_stamp, _arc_stamp, _reached, _settled;
+        std::vector<bool> _vertex_value, _arc_value;
+        ivector _parent;
+        std::vector<double> _dist;
+        Workspace();
+        void fit(int nv, int na);
+        bool fits(int nv, int na) const;
+        void new_visit();
+        bool vertex_on(int i) const {
+            return _vertex_stamp[i] == _vertex_epoch ? _vertex_value[i] : _vertex_default;
+        }
+        bool arc_on(int id) const {
+            return _arc_stamp[id] == _arc_epoch ? _arc_value[id] : _arc_default;
+        }
+        bool reached(int i) const { return _reached[i] == _visit_epoch; }
+        bool settled(int i) const { return _settled[i] == _visit_epoch; }
+        int parent(int i) const { return reached(i) ? _parent[i] : 0; }
+        double dist(int i) const { return reached(i) ? _dist[i] : DBL_MAX; }
+        void reach(int i, int p, double d) {
+            _reached[i] = _visit_epoch;
+            _parent[i] = p;
+            _dist[i] = d;
+        }
+        void settle(int i) { _settled[i] = _visit_epoch; }
+    public:
+        Workspace(const Digraph &G);
+        void enable_all_vertices(bool yes = true);
+        void enable_all_arcs(bool yes = true);
+        void set_vertex_active(int i, bool yes);
+        void set_arc_active(glp_arc *a, bool yes);
+        bool is_vertex_active(int i) const;
+        bool is_arc_active(glp_arc *a) const;
+    };
+    /* query state (activation flags, parents and distances) kept apart from the graph, so that
+     * a graph which is not modified anymore can be queried by several threads, each with its own workspace
+     *  - a workspace is constructed for a particular graph, all vertices and arcs are initially active
+     *  - the queries which only read a workspace require that it was constructed (or used by a search)
+     *    after the last vertex or arc was added to the graph
+     *  - enabling or disabling all vertices (arcs) takes constant time
+     */
 
+private:
     typedef struct {
-        bool active;
+        int id;
         double weight;
     } a_data;
 
@@ -52,14 +95,13 @@ private:
     } r_data;
 
     glp_graph *G;
-    glp_graph *P;
     int _num_arcs;
     bool _dot_tex;
     bool _is_weighted;
     std::map<int,std::string> _vlabels;
     std::vector<glp_arc*> _arcs;
 
-    glp_vertex *store_path(const ivector &path, glp_vertex *root);
+    static glp_vertex *store_path(glp_graph *P, const ivector &path, glp_vertex *root);
 
     static void select_path(glp_vertex *top);
 
@@ -69,11 +111,13 @@ private:
 
 protected:
     std::vector<double> _vc;
+    Workspace _ws; // used by the queries which are not given a workspace
 
 public:
     Digraph(bool is_weighted, bool dot_tex);
     /* constructor
      *  - is_weighted should be set to true to use arc weights
+     *  - methods which are not given a workspace use the one stored in this graph
      *  - if use_vertex_labels = true, then vertices are searchable by string labels
      *  - if dot_tex = true, then dot exports vertex labels as texlbl for processing with dot2tex
      */
@@ -102,9 +146,6 @@ public:
     glp_vertex *vertex(int i) const;
     /* returns the i-th vertex */
 
-    v_data *vertex_data(int i) const;
-    /* returns the data for vertex with index i */
-
     glp_arc *add_arc(int i, int j, double w = 1.0);
     /* adds an arc from i-th to j-th vertex with weight w */
 
@@ -127,43 +168,52 @@ public:
     /* multiplies arc weights by -1 */
 
     int in_degree(int i) const;
-    /* returns the in-degree for the i-th vertex */
+    int in_degree(int i, const Workspace &ws) const;
+    /* returns the in-degree for the i-th vertex (only active arcs are counted) */
 
     int out_degree(int i) const;
-    /* returns the out-degree for the i-th vertex */
+    int out_degree(int i, const Workspace &ws) const;
+    /* returns the out-degree for the i-th vertex (only active arcs are counted) */
 
     bool bfs(int src, int dest, ivector &path);
+    bool bfs(int src, int dest, ivector &path, Workspace &ws) const;
     /* finds a path from src to dest found by breadth-first search, return true iff one exists */
 
     void yen(int src, int dest, int K, double lb, double ub, std::vector<ivector> &paths);
+    void yen(int src, int dest, int K, double lb, double ub, std::vector<ivector> &paths, Workspace &ws) const;
     /* An implementation of Yen's algorithm for K shortest paths from src to dest vertex.
      *  - the parameters lb and ub are the lower and the upper bound for path length/weight
      *  - if K = 0, there is no limit; the algorithm finds all paths in this case
+     *  - activation flags in the workspace are restored before returning
      */
 
-    void dijkstra(int src, int dest = 0) const;
+    void dijkstra(int src, int dest = 0);
+    void dijkstra(int src, int dest, Workspace &ws) const;
     /* returns a shortest path from src to dest using Dijkstra's algorithm
      *  - if dest = 0, then all shortest paths from src are computed
      *  - paths are retrieved by get_path */
 
-    void bellman_ford(int src) const;
+    void bellman_ford(int src);
+    void bellman_ford(int src, Workspace &ws) const;
     /* runs Bellman-Ford algorithm for shortest paths from src
      *  - paths are retrieved by get_path */
 
     bool get_path(int dest, ivector &path) const;
+    bool get_path(int dest, ivector &path, const Workspace &ws) const;
     /* returns the shortest path from src to dest as computed by dijkstra(src, 0) or bellman_ford(src) */
 
     double path_weight(const ivector &path) const;
     /* returns the weight of path in this graph */
 
     void enable_all_vertices(bool yes = true);
-    /* makes all vertices active (searchable) */
+    /* makes all vertices active (searchable) in the default workspace */
 
     void enable_all_arcs(bool yes = true);
-    /* makes all arcs active (traversable) */
+    /* makes all arcs active (traversable) in the default workspace */
 
     Matrix adjacency_matrix() const;
-    /* returns the adjacency matrix (of this network) */
+    Matrix adjacency_matrix(const Workspace &ws) const;
+    /* returns the adjacency matrix (of this network), only active arcs are taken into account */
 
     bool export_dot(const char* filename, bool undirected = false) const;
     /* outputs the chord graph in dot format to file 'filename' (if filename is '-' then outputs to stdout) */
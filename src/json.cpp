@@ -0,0 +1,252 @@
+/* json.cpp
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "json.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sstream>
+
+static void skip_space(const char *&p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+        ++p;
+    }
+}
+
+/* if the input at p starts with lit, advances p past it and returns true */
+static bool skip_literal(const char *&p, const char *end, const char *lit) {
+    size_t len = strlen(lit);
+    if ((size_t)(end - p) < len || strncmp(p, lit, len) != 0)
+        return false;
+    p += len;
+    return true;
+}
+
+JsonValue::JsonValue() {
+    _kind = JSON_NULL;
+    _integral = false;
+    _int = 0;
+    _num = 0;
+}
+
+JsonValue::Kind JsonValue::kind() const {
+    return _kind;
+}
+
+bool JsonValue::is_integer() const {
+    return _kind == JSON_NUMBER && _integral;
+}
+
+long long JsonValue::integer() const {
+    assert(is_integer());
+    return _int;
+}
+
+double JsonValue::number() const {
+    assert(_kind == JSON_NUMBER);
+    return _num;
+}
+
+const std::string &JsonValue::string() const {
+    assert(_kind == JSON_STRING);
+    return _str;
+}
+
+int JsonValue::size() const {
+    return _kind == JSON_ARRAY ? _elements.size() : _members.size();
+}
+
+const JsonValue &JsonValue::operator [](int i) const {
+    assert(_kind == JSON_ARRAY && i >= 0 && i < (int)_elements.size());
+    return _elements[i];
+}
+
+bool JsonValue::has(const std::string &key) const {
+    return _kind == JSON_OBJECT && _members.find(key) != _members.end();
+}
+
+const JsonValue &JsonValue::operator [](const std::string &key) const {
+    assert(has(key));
+    return _members.at(key);
+}
+
+bool JsonValue::get(const std::string &key, int &val) const {
+    if (!has(key))
+        return false;
+    const JsonValue &v = _members.at(key);
+    if (!v.is_integer() || v._int < INT_MIN || v._int > INT_MAX)
+        return false;
+    val = v._int;
+    return true;
+}
+
+bool JsonValue::is_integer_array(int len) const {
+    if (_kind != JSON_ARRAY || (len >= 0 && (int)_elements.size() != len))
+        return false;
+    for (std::vector<JsonValue>::const_iterator it = _elements.begin(); it != _elements.end(); ++it) {
+        if (!it->is_integer())
+            return false;
+    }
+    return true;
+}
+
+bool JsonValue::parse_value(const char *&p, const char *end, std::string &error) {
+    skip_space(p, end);
+    if (p == end) {
+        error = "unexpected end of input";
+        return false;
+    }
+    if (*p == '{' || *p == '[') {
+        bool is_obj = *(p++) == '{';
+        _kind = is_obj ? JSON_OBJECT : JSON_ARRAY;
+        skip_space(p, end);
+        if (p < end && *p == (is_obj ? '}' : ']')) {
+            ++p;
+            return true;
+        }
+        while (true) {
+            JsonValue v;
+            if (is_obj) {
+                JsonValue key;
+                skip_space(p, end);
+                if (p == end || *p != '"' || !key.parse_value(p, end, error)) {
+                    if (error.empty())
+                        error = "expected a member name";
+                    return false;
+                }
+                skip_space(p, end);
+                if (p == end || *(p++) != ':') {
+                    error = "expected ':'";
+                    return false;
+                }
+                if (!v.parse_value(p, end, error))
+                    return false;
+                _members[key._str] = v;
+            } else {
+                if (!v.parse_value(p, end, error))
+                    return false;
+                _elements.push_back(v);
+            }
+            skip_space(p, end);
+            if (p < end && *p == ',') {
+                ++p;
+                continue;
+            }
+            if (p < end && *p == (is_obj ? '}' : ']')) {
+                ++p;
+                return true;
+            }
+            error = is_obj ? "expected ',' or '}'" : "expected ',' or ']'";
+            return false;
+        }
+    }
+    if (*p == '"') {
+        _kind = JSON_STRING;
+        for (++p; p < end && *p != '"'; ++p) {
+            if (*p == '\\') {
+                if (++p == end)
+                    break;
+                switch (*p) {
+                case 'n': _str += '\n'; break;
+                case 't': _str += '\t'; break;
+                case 'r': _str += '\r'; break;
+                case 'b': _str += '\b'; break;
+                case 'f': _str += '\f'; break;
+                case 'u': // only ASCII escapes are produced by quote
+                    if (end - p < 5) {
+                        error = "invalid escape sequence";
+                        return false;
+                    }
+                    _str += (char)strtol(std::string(p + 1, 4).c_str(), NULL, 16);
+                    p += 4;
+                    break;
+                default: _str += *p;
+                }
+            } else _str += *p;
+        }
+        if (p == end) {
+            error = "unterminated string";
+            return false;
+        }
+        ++p;
+        return true;
+    }
+    if (skip_literal(p, end, "true")) {
+        _kind = JSON_BOOL;
+        _int = 1;
+        return true;
+    }
+    if (skip_literal(p, end, "false")) {
+        _kind = JSON_BOOL;
+        return true;
+    }
+    if (skip_literal(p, end, "null"))
+        return true;
+    const char *q = p;
+    if (*q == '-')
+        ++q;
+    const char *digits = q;
+    for (; q < end && *q >= '0' && *q <= '9'; ++q);
+    if (q == digits) {
+        error = "unexpected character '" + std::string(1, *p) + "'";
+        return false;
+    }
+    _integral = q == end || (*q != '.' && *q != 'e' && *q != 'E');
+    for (; q < end && ((*q >= '0' && *q <= '9') || *q == '.' || *q == 'e' || *q == 'E' || *q == '+' || *q == '-'); ++q);
+    std::string num(p, q);
+    _kind = JSON_NUMBER;
+    _num = strtod(num.c_str(), NULL);
+    _int = _integral ? strtoll(num.c_str(), NULL, 10) : (long long)_num;
+    p = q;
+    return true;
+}
+
+bool JsonValue::parse(std::istream &is, JsonValue &v, std::string &error) {
+    std::stringstream ss;
+    ss << is.rdbuf();
+    std::string text = ss.str();
+    const char *p = text.data(), *end = p + text.size();
+    v = JsonValue();
+    error.clear();
+    if (!v.parse_value(p, end, error))
+        return false;
+    skip_space(p, end);
+    if (p != end) {
+        error = "trailing characters after the document";
+        return false;
+    }
+    return true;
+}
+
+std::string JsonValue::quote(const std::string &s) {
+    std::string ret = "\"";
+    char buf[8];
+    for (std::string::const_iterator it = s.begin(); it != s.end(); ++it) {
+        if (*it == '"' || *it == '\\')
+            ret += std::string("\\") + *it;
+        else if ((unsigned char)*it < 0x20) {
+            sprintf(buf, "\\u%04x", (unsigned char)*it);
+            ret += buf;
+        } else ret += *it;
+    }
+    return ret + "\"";
+}
@@ -0,0 +1,97 @@
+/* json.h
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <istream>
+#include <ostream>
+
+/* A minimal JSON document model, sufficient for reading the snapshots written by the statistics classes. */
+class JsonValue {
+
+public:
+    enum Kind {
+        JSON_NULL = 0,
+        JSON_BOOL = 1,
+        JSON_NUMBER = 2,
+        JSON_STRING = 3,
+        JSON_ARRAY = 4,
+        JSON_OBJECT = 5
+    };
+
+private:
+    Kind _kind;
+    bool _integral;
+    long long _int;
+    double _num;
+    std::string _str;
+    std::vector<JsonValue> _elements;
+    std::map<std::string,JsonValue> _members;
+
+    bool parse_value(const char *&p, const char *end, std::string &error);
+
+public:
+    JsonValue();
+
+    Kind kind() const;
+    /* returns the kind of this value */
+
+    bool is_integer() const;
+    /* returns true iff this is a number without fractional part and exponent */
+
+    long long integer() const;
+    /* returns the integer value (this must be an integer) */
+
+    double number() const;
+    /* returns the numeric value (this must be a number) */
+
+    const std::string &string() const;
+    /* returns the string value (this must be a string) */
+
+    int size() const;
+    /* returns the number of elements of an array or members of an object */
+
+    const JsonValue &operator [](int i) const;
+    /* returns the i-th element of an array */
+
+    bool has(const std::string &key) const;
+    /* returns true iff this is an object which has the given member */
+
+    const JsonValue &operator [](const std::string &key) const;
+    /* returns the member with the given key (this must be an object which has it) */
+
+    bool get(const std::string &key, int &val) const;
+    /* if this is an object whose member key is an integer which fits into int, stores it into val and returns true */
+
+    bool is_integer_array(int len = -1) const;
+    /* returns true iff this is an array of integers (of length len, if len >= 0) */
+
+    static bool parse(std::istream &is, JsonValue &v, std::string &error);
+    /* reads a JSON document from is into v, returns false and sets error on failure */
+
+    static std::string quote(const std::string &s);
+    /* returns s as a JSON string literal */
+};
+
+#endif // JSON_H
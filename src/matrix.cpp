@@ -19,6 +19,7 @@
  */
 
 #include "matrix.h"
+#include "profile.h"
 #include <assert.h>
 #include <iostream>
 #include <gsl/gsl_math.h>
@@ -108,6 +109,7 @@ void Matrix::mul(const Matrix &other, int row, int col) {
 }
 
 Matrix Matrix::exponential() const {
+    Profile::count(PROFILE_MATRIX_EXPONENTIALS);
     int s = _size, s2 = s * s;
     double data[s2], zdata[s2];
     for (std::vector<double>::const_iterator it = _elm.begin(); it != _elm.end(); ++it) {
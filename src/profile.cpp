@@ -0,0 +1,190 @@
+/* profile.cpp
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "profile.h"
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+namespace {
+
+struct phase_stats {
+    long long calls;
+    double wall;
+    double cpu;
+    phase_stats() : calls(0), wall(0), cpu(0) { }
+};
+
+struct trace_event {
+    const char *name;
+    int tid;
+    double ts; // microseconds since the profile epoch
+    double dur;
+};
+
+std::mutex profile_mutex;
+std::map<std::string,phase_stats> phases;
+std::vector<trace_event> events;
+std::map<std::thread::id,int> thread_ids;
+std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+}
+
+std::atomic<bool> Profile::_enabled(false);
+std::atomic<bool> Profile::_tracing(false);
+std::atomic<long long> Profile::_counters[PROFILE_NUM_COUNTERS];
+
+const char *Profile::counter_names[] = {
+    "realizations enumerated",
+    "transitions generated",
+    "transitions deduplicated",
+    "chord graph arcs",
+    "network vertices",
+    "network arcs",
+    "glue calls",
+    "Dijkstra invocations",
+    "Yen invocations",
+    "relaxations",
+    "matrix exponentials",
+    "voicing candidates pruned",
+    "cached levels reused",
+    "transposed results reused",
+    "editor messages updated"
+};
+
+Profile::Timer::Timer(const char *name) {
+    _name = name;
+    _active = Profile::is_enabled();
+    if (_active) {
+        _start = std::chrono::steady_clock::now();
+        _cpu_start = Profile::cpu_time();
+    }
+}
+
+Profile::Timer::~Timer() {
+    if (!_active)
+        return;
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - _start;
+    Profile::record(_name, _start, wall.count(), Profile::cpu_time() - _cpu_start);
+}
+
+void Profile::record(const char *name, std::chrono::steady_clock::time_point start, double wall, double cpu) {
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    phase_stats &ps = phases[name];
+    ++ps.calls;
+    ps.wall += wall;
+    ps.cpu += cpu;
+    if (_tracing.load(std::memory_order_relaxed)) {
+        int tid = thread_ids.size();
+        tid = thread_ids.insert(std::make_pair(std::this_thread::get_id(), tid)).first->second;
+        trace_event e;
+        e.name = name;
+        e.tid = tid;
+        e.ts = std::chrono::duration<double,std::micro>(start - epoch).count();
+        e.dur = wall * 1e6;
+        events.push_back(e);
+    }
+}
+
+void Profile::enable(bool trace) {
+    _tracing = trace;
+    _enabled = true;
+}
+
+void Profile::disable() {
+    _enabled = false;
+    _tracing = false;
+}
+
+bool Profile::is_enabled() {
+    return _enabled.load(std::memory_order_relaxed);
+}
+
+void Profile::reset() {
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    for (int c = 0; c < PROFILE_NUM_COUNTERS; ++c) {
+        _counters[c] = 0;
+    }
+    phases.clear();
+    events.clear();
+    thread_ids.clear();
+    epoch = std::chrono::steady_clock::now();
+}
+
+long long Profile::counter(ProfileCounter c) {
+    return _counters[c].load();
+}
+
+double Profile::cpu_time() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0)
+        return 0;
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void Profile::write_table(std::ostream &os) {
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    os << std::left << std::setw(48) << "phase" << std::right << std::setw(10) << "calls"
+       << std::setw(14) << "wall [s]" << std::setw(14) << "CPU [s]" << "\n";
+    for (std::map<std::string,phase_stats>::const_iterator it = phases.begin(); it != phases.end(); ++it) {
+        os << std::left << std::setw(48) << it->first << std::right << std::setw(10) << it->second.calls
+           << std::setw(14) << it->second.wall << std::setw(14) << it->second.cpu << "\n";
+    }
+    os << "\n" << std::left << std::setw(48) << "counter" << std::right << std::setw(10) << "value" << "\n";
+    for (int c = 0; c < PROFILE_NUM_COUNTERS; ++c) {
+        os << std::left << std::setw(48) << counter_names[c] << std::right << std::setw(10) << _counters[c].load() << "\n";
+    }
+    os << std::flush;
+}
+
+void Profile::write_json(std::ostream &os) {
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    os << "{\n  \"phases\": [";
+    for (std::map<std::string,phase_stats>::const_iterator it = phases.begin(); it != phases.end(); ++it) {
+        os << (it == phases.begin() ? "\n" : ",\n")
+           << "    {\"name\": \"" << it->first << "\", \"calls\": " << it->second.calls
+           << ", \"wall\": " << it->second.wall << ", \"cpu\": " << it->second.cpu << "}";
+    }
+    os << "\n  ],\n  \"counters\": {";
+    for (int c = 0; c < PROFILE_NUM_COUNTERS; ++c) {
+        os << (c == 0 ? "\n" : ",\n") << "    \"" << counter_names[c] << "\": " << _counters[c].load();
+    }
+    os << "\n  }\n}" << std::endl;
+}
+
+bool Profile::write_trace(const char *filename) {
+    std::ofstream ofs(filename);
+    if (!ofs.is_open())
+        return false;
+    std::lock_guard<std::mutex> lock(profile_mutex);
+    ofs << "{\"traceEvents\": [";
+    for (std::vector<trace_event>::const_iterator it = events.begin(); it != events.end(); ++it) {
+        ofs << (it == events.begin() ? "\n" : ",\n") << std::fixed << std::setprecision(3)
+            << "  {\"name\": \"" << it->name << "\", \"cat\": \"septima\", \"ph\": \"X\", \"pid\": 1"
+            << ", \"tid\": " << it->tid << ", \"ts\": " << it->ts << ", \"dur\": " << it->dur << "}";
+    }
+    ofs << "\n], \"displayTimeUnit\": \"ms\"}" << std::endl;
+    return true;
+}
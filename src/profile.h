@@ -0,0 +1,106 @@
+/* profile.h
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+
+enum ProfileCounter {
+    PROFILE_REALIZATIONS = 0,
+    PROFILE_TRANSITIONS_GENERATED = 1,
+    PROFILE_TRANSITIONS_DEDUPLICATED = 2,
+    PROFILE_CHORD_GRAPH_ARCS = 3,
+    PROFILE_NETWORK_VERTICES = 4,
+    PROFILE_NETWORK_ARCS = 5,
+    PROFILE_GLUE_CALLS = 6,
+    PROFILE_DIJKSTRA_CALLS = 7,
+    PROFILE_YEN_CALLS = 8,
+    PROFILE_RELAXATIONS = 9,
+    PROFILE_MATRIX_EXPONENTIALS = 10,
+    PROFILE_VOICING_CANDIDATES_PRUNED = 11,
+    PROFILE_CACHED_LEVELS_REUSED = 12,
+    PROFILE_TRANSPOSED_RESULTS_REUSED = 13,
+    PROFILE_EDITOR_MESSAGES_UPDATED = 14,
+    PROFILE_NUM_COUNTERS = 15
+};
+
+class Profile {
+
+    static std::atomic<bool> _enabled;
+    static std::atomic<bool> _tracing;
+    static std::atomic<long long> _counters[PROFILE_NUM_COUNTERS];
+
+    static void record(const char *name, std::chrono::steady_clock::time_point start, double wall, double cpu);
+
+public:
+    class Timer {
+        const char *_name;
+        bool _active;
+        std::chrono::steady_clock::time_point _start;
+        double _cpu_start;
+    public:
+        Timer(const char *name);
+        ~Timer();
+    };
+    /* scoped timer which adds the wall and process CPU time elapsed in its lifetime to the named phase
+     * (does nothing unless profiling is enabled) */
+
+    static void enable(bool trace = false);
+    /* starts collecting timings and counters
+     *  - if trace = true, each timer interval is also recorded for write_trace
+     */
+
+    static void disable();
+    /* stops collecting timings and counters */
+
+    static bool is_enabled();
+    /* returns true iff profiling is enabled */
+
+    static void reset();
+    /* clears all timings, counters and recorded intervals */
+
+    static void count(ProfileCounter c, long long n = 1) {
+        if (_enabled.load(std::memory_order_relaxed))
+            _counters[c].fetch_add(n, std::memory_order_relaxed);
+    }
+    /* adds n to the counter c */
+
+    static long long counter(ProfileCounter c);
+    /* returns the value of the counter c */
+
+    static double cpu_time();
+    /* returns the CPU time in seconds consumed by all threads of the process */
+
+    static void write_table(std::ostream &os);
+    /* writes timings and counters to os as a human-readable table */
+
+    static void write_json(std::ostream &os);
+    /* writes timings and counters to os as a JSON object */
+
+    static bool write_trace(const char *filename);
+    /* writes the recorded intervals to the given file in Chrome trace event format, returns true on success */
+
+    static const char *counter_names[];
+};
+
+#endif // PROFILE_H
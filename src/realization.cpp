@@ -19,6 +19,7 @@
  */
 
 #include "realization.h"
+#include "profile.h"
 #include <assert.h>
 #include <set>
 #include <algorithm>
@@ -250,39 +251,45 @@ std::vector<Realization> Realization::tonal_realizations(const Chord &c, const D
                 ret.push_back(r);
         }
     }
+    Profile::count(PROFILE_REALIZATIONS, ret.size());
     return ret;
 }
 
+/* Each pitch class is realized by an arithmetic progression on the line of fifths with step 12,
+ * so it suffices to combine one of its representatives in dom per pitch class. */
 std::set<std::vector<int> > Realization::lof_patterns(const Chord &c, int &tot, int &ton, const Domain &dom) {
-    std::set<int> Pc = c.pitch_class_set(), Rp;
-    int k1, k2, k3, k4;
+    std::set<int> Pc = c.pitch_class_set();
+    assert(Pc.size() == 4);
+    std::vector<std::vector<int> > reps;
+    int lb = dom.lbound(), ub = dom.ubound(), k, i;
+    for (std::set<int>::const_iterator it = Pc.begin(); it != Pc.end(); ++it) {
+        std::vector<int> lst;
+        for (k = lb + Tone::modb(7 * (*it - 2) - lb, 12); k <= ub; k += 12) {
+            if (dom.find(Tone(k)) != dom.end())
+                lst.push_back(k);
+        }
+        if (lst.empty())
+            return std::set<std::vector<int> >();
+        reps.push_back(lst);
+    }
     Realization r;
     std::vector<int> pat(4), sig(3);
     std::set<std::vector<int> > ret;
-    int lb = dom.lbound(), ub = dom.ubound();
-    for (k1 = lb; k1 <= ub; ++k1) {
-        r.tone(0) = Tone(k1);
-        for (k2 = k1 + 1; k2 <= ub; ++k2) {
-            r.tone(1) = Tone(k2);
-            for (k3 = k2 + 1; k3 <= ub; ++k3) {
-                r.tone(2) = Tone (k3);
-                for (k4 = k3 + 1; k4 <= ub; ++k4) {
-                    r.tone(3) = Tone (k4);
-                    if (!dom.contains(r.tone_set()))
-                        continue;
-                    Rp.clear();
-                    for (int i = 0; i < 4; ++i) {
-                        Rp.insert(r.tone(i).pitch_class());
-                    }
-                    if (Rp != Pc)
-                        continue;
+    std::vector<int>::const_iterator it[4];
+    for (it[0] = reps[0].begin(); it[0] != reps[0].end(); ++it[0]) {
+        for (it[1] = reps[1].begin(); it[1] != reps[1].end(); ++it[1]) {
+            for (it[2] = reps[2].begin(); it[2] != reps[2].end(); ++it[2]) {
+                for (it[3] = reps[3].begin(); it[3] != reps[3].end(); ++it[3]) {
                     ++tot;
+                    for (i = 0; i < 4; ++i) {
+                        r.tone(i) = Tone(*it[i]);
+                    }
                     if (r.check_fifths()) {
-                        for (int i = 0; i < 4; ++i) {
+                        for (i = 0; i < 4; ++i) {
                             pat[i] = r.tone(i).lof_position();
                         }
                         std::sort(pat.begin(), pat.end());
-                        for (int i = 0; i < 3; ++i) {
+                        for (i = 0; i < 3; ++i) {
                             sig[i] = pat[i+1] - pat[i];
                         }
                         ret.insert(sig);
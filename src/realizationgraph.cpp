@@ -0,0 +1,316 @@
+/* realizationgraph.cpp
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "realizationgraph.h"
+#include "transitionnetwork.h"
+#include "profile.h"
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+
+RealizationGraph::RealizationGraph(const ChordGraph &cg) :
+    _cg(cg)
+{
+    Profile::Timer timer("RealizationGraph::RealizationGraph");
+    const Domain &dom = cg.support();
+    int n = cg.number_of_vertices(), i, j, k;
+    _zmin = dom.lbound();
+    _nz = dom.ubound() - dom.lbound() + 1;
+    /* the realizations which may precede a transition out of each chord */
+    std::vector<std::set<int> > states(n + 1);
+    _initial.resize(n + 1);
+    for (i = 1; i <= n; ++i) {
+        std::vector<Realization> R = Realization::tonal_realizations(cg.vertex2chord(i), dom, cg.allows_augmented_sixths());
+        for (std::vector<Realization>::const_iterator it = R.begin(); it != R.end(); ++it) {
+            _initial[i].push_back(add_vertex(*it));
+            states[i].insert(_initial[i].back());
+        }
+    }
+    _trans_start.push_back(0);
+    for (i = 1; i <= n; ++i) {
+        for (j = 1; j <= n; ++j) {
+            glp_arc *a = i == j ? NULL : cg.arc(i, j);
+            if (a == NULL)
+                continue;
+            _arc_index[a] = _trans_start.size() - 1;
+            const std::set<Transition> &ta = cg.transitions(a);
+            for (std::set<Transition>::const_iterator it = ta.begin(); it != ta.end(); ++it) {
+                _trans.push_back(&(*it));
+                _target.push_back(add_vertex(it->second()));
+                states[j].insert(_target.back());
+            }
+            _trans_start.push_back(_trans.size());
+        }
+    }
+    /* copy the glue data of the chord graph */
+    for (i = 1; i <= n; ++i) {
+        for (j = 1; j <= n; ++j) {
+            int ai = i == j ? -1 : arc_index(i, j);
+            if (ai < 0)
+                continue;
+            const ChordGraph::GlueTable &gt = cg.glue_table(i, j);
+            double min_vl = DBL_MAX;
+            for (std::set<int>::const_iterator it = states[i].begin(); it != states[i].end(); ++it) {
+                _rows[std::make_pair(ai, *it)] = _vl.size();
+                const ChordGraph::GlueTable::entry *row = gt.row(cg.predecessor_index(i, _vertices[*it]));
+                for (k = 0; k < gt.size(); ++k) {
+                    _vl.push_back(sqrt(row[k].tcn / 4));
+                    _phi.push_back(row[k].phi);
+                    _cue.push_back(row[k].mc > 0);
+                    min_vl = std::min(min_vl, _vl.back());
+                }
+            }
+            _min_vl.push_back(min_vl);
+        }
+    }
+    /* distances to the points of the support */
+    _spread.resize(_vertices.size() * _nz);
+    for (i = 0; i < (int)_vertices.size(); ++i) {
+        for (int z = 0; z < _nz; ++z) {
+            _spread[i * _nz + z] = _vertices[i].lof_point_distance(_zmin + z);
+        }
+    }
+}
+
+ivector RealizationGraph::key(const Realization &r) {
+    ivector ret(5);
+    ret[0] = r.chord().id();
+    for (int i = 0; i < 4; ++i) {
+        ret[i+1] = r.tone(i).lof_position();
+    }
+    return ret;
+}
+
+int RealizationGraph::add_vertex(const Realization &r) {
+    std::pair<std::map<ivector,int>::iterator,bool> res = _vertex_index.insert(std::make_pair(key(r), (int)_vertices.size()));
+    if (res.second) {
+        _vertices.push_back(r);
+        _aug.push_back(r.is_augmented_sixth());
+    }
+    return res.first->second;
+}
+
+int RealizationGraph::arc_index(int i, int j) const {
+    glp_arc *a = _cg.arc(i, j);
+    if (a == NULL)
+        return -1;
+    return _arc_index.at(a);
+}
+
+int RealizationGraph::row(int arc, int x) const {
+    return _rows.at(std::make_pair(arc, x));
+}
+
+double RealizationGraph::spread(int x, int z) const {
+    assert(z >= _zmin && z < _zmin + _nz);
+    return _spread[x * _nz + z - _zmin];
+}
+
+const ChordGraph &RealizationGraph::chord_graph() const {
+    return _cg;
+}
+
+int RealizationGraph::number_of_realizations() const {
+    return _vertices.size();
+}
+
+int RealizationGraph::number_of_glue_entries() const {
+    return _vl.size();
+}
+
+/* The dynamic program and its tie-breaking rules are those of TransitionNetwork::solve, and the weights
+ * are computed with the same floating-point operations as in TransitionNetwork::arc_weight,
+ * first_arc_weight and initial_weight, hence the results are identical. */
+double RealizationGraph::solve(const ivector &walk, int x0, const std::vector<double> &wgh, int z, voicing &v) const {
+    int nl = walk.size() - 1, l, i, j, n1, n2, p, t1, t2, e, rw;
+    const int X0 = _initial[walk.front()].at(x0);
+    const double w0 = wgh[0], w1 = wgh[1], w2 = wgh[2];
+    double c, wg, c0 = w0 * spread(X0, z);
+    v.clear();
+    if (nl == 0) {
+        v.push_back(std::make_pair(_vertices[X0], false));
+        return _aug[X0] ? c0 + w2 : c0;
+    }
+    ivector arcs(nl + 1), start(nl + 1);
+    for (l = 1; l <= nl; ++l) {
+        arcs[l] = arc_index(walk[l-1], walk[l]);
+        assert(arcs[l] >= 0);
+        start[l] = _trans_start[arcs[l]];
+    }
+    std::vector<ivector> parent(nl + 1);
+    /* costs and sources of the cheapest paths to the vertices in the current level */
+    const int row0 = row(arcs[1], X0);
+    n1 = _trans_start[arcs[1]+1] - start[1];
+    std::vector<double> cost(n1, 0), next_cost, wd;
+    ivector src(n1), next_src;
+    for (i = 0; i < n1; ++i) {
+        src[i] = i;
+    }
+    for (l = 1; l < nl; ++l) {
+        n1 = _trans_start[arcs[l]+1] - start[l];
+        n2 = _trans_start[arcs[l+1]+1] - start[l+1];
+        next_cost.assign(n2, DBL_MAX);
+        next_src.assign(n2, -1);
+        parent[l+1].assign(n2, -1);
+        wd.resize(n2);
+        for (j = 0; j < n2; ++j) {
+            wd[j] = w0 * spread(_target[start[l+1] + j], z);
+        }
+        for (i = 0; i < n1; ++i) {
+            t1 = _target[start[l] + i];
+            rw = row(arcs[l+1], t1);
+            for (j = 0; j < n2; ++j) {
+                t2 = _target[start[l+1] + j];
+                e = rw + j;
+                wg = wd[j] + _vl[e] * w1;
+                if (_aug[t2])
+                    wg += w2;
+                if (l == 1) {
+                    wg += c0;
+                    wg += w0 * spread(t1, z) + _vl[row0 + i] * w1;
+                    if (_aug[t1])
+                        wg += w2;
+                    if (_aug[X0])
+                        wg += w2;
+                }
+                c = cost[i] + wg;
+                p = parent[l+1][j];
+                if (p < 0 || c < next_cost[j] ||
+                        (c == next_cost[j] && (src[i] < next_src[j] || (src[i] == next_src[j] && cost[i] < cost[p])))) {
+                    next_cost[j] = c;
+                    next_src[j] = src[i];
+                    parent[l+1][j] = i;
+                }
+            }
+        }
+        cost.swap(next_cost);
+        src.swap(next_src);
+    }
+    /* choose the sink */
+    n2 = _trans_start[arcs[nl]+1] - start[nl];
+    int best = 0;
+    if (nl == 1) {
+        for (j = 0; j < n2; ++j) {
+            t1 = _target[start[1] + j];
+            wg = _aug[X0] ? c0 + w2 : c0;
+            wg += w0 * spread(t1, z) + _vl[row0 + j] * w1;
+            if (_aug[t1])
+                wg += w2;
+            cost[j] = wg;
+        }
+    }
+    for (j = 1; j < n2; ++j) {
+        if (cost[j] < cost[best] || (cost[j] == cost[best] && src[j] < src[best]))
+            best = j;
+    }
+    ivector path(nl + 1);
+    path[nl] = best;
+    for (l = nl; l > 1; --l) {
+        path[l-1] = parent[l][path[l]];
+    }
+    /* realize the path */
+    ivector f(4);
+    for (l = 1; l <= nl; ++l) {
+        const Transition &t = *_trans[start[l] + path[l]];
+        e = (l == 1 ? row0 : row(arcs[l], _target[start[l-1] + path[l-1]])) + path[l];
+        ivector phi(Transition::sym4[_phi[e]], Transition::sym4[_phi[e]] + 4);
+        f = l == 1 ? phi : TransitionNetwork::compose(f, phi);
+        if (l == 1)
+            v.push_back(std::make_pair(_vertices[X0], false));
+        if (_cue[e]) {
+            Realization r1 = t.first();
+            r1.arrange(f);
+            v.push_back(std::make_pair(r1, true));
+        }
+        Realization r2 = t.second();
+        r2.arrange(f);
+        v.push_back(std::make_pair(r2, false));
+    }
+    return cost[best];
+}
+
+/* The pairs (X0,z) are pruned as in TransitionNetwork::find_voicing, with the same lower bounds. */
+int RealizationGraph::find_voicing(const ivector &walk, const std::vector<double> &wgh, voicing &v) const {
+    Profile::Timer timer("RealizationGraph::find_voicing");
+    int nl = walk.size() - 1, best_z = 0, best_order = -1, nr = _initial[walk.front()].size(), l, k, x, z, a, order;
+    bool prune = wgh[0] >= 0 && wgh[1] >= 0 && wgh[2] >= 0;
+    double w, min_w = 0, d;
+    std::vector<double> lb(_nz, 0), min_d(_nz);
+    for (l = 1; l <= nl; ++l) {
+        a = arc_index(walk[l-1], walk[l]);
+        std::fill(min_d.begin(), min_d.end(), DBL_MAX);
+        for (k = _trans_start[a]; k < _trans_start[a+1]; ++k) {
+            x = _target[k];
+            for (z = 0; z < _nz; ++z) {
+                d = wgh[0] * _spread[x * _nz + z];
+                if (_aug[x])
+                    d += wgh[2];
+                min_d[z] = std::min(min_d[z], d);
+            }
+        }
+        for (z = 0; z < _nz; ++z) {
+            lb[z] += min_d[z] + _min_vl[a] * wgh[1];
+        }
+    }
+    std::vector<std::pair<double,int> > cand;
+    for (int i = 0; i < nr; ++i) {
+        x = _initial[walk.front()][i];
+        for (z = 0; z < _nz; ++z) {
+            w = lb[z] + wgh[0] * _spread[x * _nz + z] + (_aug[x] ? wgh[2] : 0.0);
+            cand.push_back(std::make_pair(prune ? w * (1.0 - 1e-9) : 0.0, i * _nz + z));
+        }
+    }
+    std::sort(cand.begin(), cand.end());
+    voicing sv;
+    for (std::vector<std::pair<double,int> >::const_iterator it = cand.begin(); it != cand.end(); ++it) {
+        if (prune && best_order >= 0 && it->first > min_w) {
+            Profile::count(PROFILE_VOICING_CANDIDATES_PRUNED, cand.end() - it);
+            break;
+        }
+        order = it->second;
+        w = solve(walk, order / _nz, wgh, _zmin + order % _nz, sv);
+        if (best_order < 0 || w < min_w || (w == min_w && order < best_order)) {
+            v = sv;
+            min_w = w;
+            best_order = order;
+            best_z = _zmin + order % _nz;
+        }
+    }
+    TransitionNetwork::arrange_voices(v);
+    return best_z;
+}
+
+bool RealizationGraph::find_voicing(const std::vector<Chord> &seq, int &z0,
+                                    double spread_weight, double vl_weight, double aug_weight, voicing &v) const {
+    ivector walk;
+    for (std::vector<Chord>::const_iterator it = seq.begin(); it != seq.end(); ++it) {
+        int i = _cg.find_vertex_by_chord(*it);
+        if (i == 0 || (it != seq.begin() && _cg.arc(walk.back(), i) == NULL))
+            return false;
+        walk.push_back(i);
+    }
+    std::vector<double> wgh;
+    wgh.push_back(spread_weight);
+    wgh.push_back(vl_weight);
+    wgh.push_back(aug_weight);
+    z0 = find_voicing(walk, wgh, v);
+    return true;
+}
@@ -0,0 +1,88 @@
+/* realizationgraph.h
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef REALIZATIONGRAPH_H
+#define REALIZATIONGRAPH_H
+
+#include "chordgraph.h"
+
+/* A precompiled graph whose vertices are the realizations which may occur in voicings of walks in a chord graph,
+ * i.e. the tonal realizations in the support and the second realizations of the elementary transitions.
+ * For each arc of the chord graph and each realization X of its source chord, the gluing of every transition
+ * on that arc to X is stored (voice mapping, cue flag and the voice-leading term of the arc weight),
+ * as well as the distances of all realizations to the points of the support.
+ * Voicing a walk is then a shortest-path query over layers of realizations which needs no gluing. */
+class RealizationGraph {
+
+    const ChordGraph &_cg;
+    int _zmin;
+    int _nz;
+    std::vector<Realization> _vertices;
+    std::map<ivector,int> _vertex_index;    // keyed by the chord id followed by the voices on the line of fifths
+    std::vector<bool> _aug;                 // true iff the realization is an augmented sixth
+    std::vector<double> _spread;            // lof_point_distance for each realization and each point of the support
+    std::vector<ivector> _initial;          // the tonal realizations of each chord (indexed by chord graph vertices)
+    std::map<glp_arc*,int> _arc_index;
+    ivector _trans_start;                   // the first transition of each arc
+    std::vector<const Transition*> _trans;
+    ivector _target;                        // the second realization of each transition
+    std::map<ipair,int> _rows;              // the first glue entry for each arc and source realization
+    std::vector<double> _vl;                // the voice-leading term sqrt(tcn/4), see TransitionNetwork::arc_weight
+    std::vector<unsigned char> _phi;        // the voice mapping, given as an index in Transition::sym4
+    std::vector<bool> _cue;                 // true iff a cue is required
+    std::vector<double> _min_vl;            // the least voice-leading term of each arc
+
+    static ivector key(const Realization &r);
+
+    int add_vertex(const Realization &r);
+    int arc_index(int i, int j) const;
+    int row(int arc, int x) const;
+    double spread(int x, int z) const;
+
+public:
+    RealizationGraph(const ChordGraph &cg);
+    /* precompiles the realization graph for cg, which must outlive this object */
+
+    const ChordGraph &chord_graph() const;
+    /* returns the underlying chord graph */
+
+    int number_of_realizations() const;
+    /* returns the number of vertices */
+
+    int number_of_glue_entries() const;
+    /* returns the number of stored pairs (source realization, transition) */
+
+    double solve(const ivector &walk, int x0, const std::vector<double> &wgh, int z, voicing &v) const;
+    /* finds a cheapest voicing v for walk in the chord graph starting with the x0-th tonal realization
+     * of the first chord, with center of gravity z and weights wgh, and returns its weight
+     *  - the result is the same as with TransitionNetwork::solve
+     */
+
+    int find_voicing(const ivector &walk, const std::vector<double> &wgh, voicing &v) const;
+    /* finds an optimal voicing v for walk in the chord graph and returns its gravity center on the line of fifths
+     *  - the result is the same as with TransitionNetwork::find_voicing
+     */
+
+    bool find_voicing(const std::vector<Chord> &seq, int &z0,
+                      double spread_weight, double vl_weight, double aug_weight, voicing &v) const;
+    /* finds an optimal voicing for chord sequence seq, see ChordGraph::find_voicing */
+};
+
+#endif // REALIZATIONGRAPH_H
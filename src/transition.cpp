@@ -19,10 +19,14 @@
  */
 
 #include "transition.h"
+#include "profile.h"
 #include <assert.h>
 #include <map>
 #include <cmath>
 #include <sstream>
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
 
 Transition::Transition(const Realization &a, const Realization &b) {
     _first = a;
@@ -151,6 +155,7 @@ bool Transition::operator <(const Transition &other) const {
 }
 
 bool Transition::glue(const Realization &pred, int &mc, int &tcn, std::vector<int> &f, int k) const {
+    Profile::count(PROFILE_GLUE_CALLS);
     if (!pred.is_enharmonically_equal(_first))
         return false;
     f = std::vector<int>(4, -1);
@@ -495,25 +500,119 @@ const int Transition::sym4[][4] = {
     {3, 1, 0, 2}, {3, 1, 2, 0}, {3, 2, 0, 1}, {3, 2, 1, 0}
 };
 
+int Transition::sym4_index(const std::vector<int> &f) {
+    assert(f.size() == 4);
+    for (int i = 0; i < 24; ++i) {
+        if (sym4[i][0] == f[0] && sym4[i][1] == f[1] && sym4[i][2] == f[2])
+            return i;
+    }
+    assert(false);
+    return -1;
+}
+
+/* The byte i of the shuffle control for the voice j is sym4[i][j], or 0x80 (which yields zero) if i >= 24.
+ * The matrix rows are broadcast to all 32-bit lanes, hence a shuffle picks d[j][sym4[i][j]] for each
+ * permutation at once, even with AVX2, which shuffles bytes only within 128-bit halves. */
+#if defined(__AVX2__) || defined(__SSSE3__)
+static const unsigned char sym4_shuffle[4][32] = {
+    {0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {1, 1, 2, 2, 3, 3, 0, 0, 2, 2, 3, 3, 0, 0, 1, 1, 3, 3, 0, 0, 1, 1, 2, 2, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {2, 3, 1, 3, 1, 2, 2, 3, 0, 3, 0, 2, 1, 3, 0, 3, 0, 1, 1, 2, 0, 2, 0, 1, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {3, 2, 3, 1, 2, 1, 3, 2, 3, 0, 2, 0, 3, 1, 3, 0, 1, 0, 2, 1, 2, 0, 1, 0, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80}
+};
+#endif
+
+/* returns Tone::modd(3*d,7) for d >= 0 */
+static int diatonic_term(int d) {
+    int n = (3 * d) % 7;
+    return n > 3 ? 7 - n : n;
+}
+
+/* The terms modd(3*d,7) are at most 3, hence their sums fit in a byte. So do the distances, unless they are
+ * very large, in which case the permutations are tested one by one. */
+unsigned int Transition::sym4_mask(const int d[4][4], int k, int s) {
+    int i, j, m, max_d, sum_t;
+    unsigned int mask = 0;
+    if (k < 0 || s < 0 || s > 12)
+        return 0;
+#if defined(__AVX2__) || defined(__SSSE3__)
+    bool small = k < 255;
+    for (j = 0; j < 4; ++j) {
+        for (m = 0; m < 4; ++m) {
+            small = small && d[j][m] < 255;
+        }
+    }
+    if (small) {
+        unsigned int row_d[4], row_t[4];
+        for (j = 0; j < 4; ++j) {
+            row_d[j] = row_t[j] = 0;
+            for (m = 0; m < 4; ++m) {
+                row_d[j] |= (unsigned int)d[j][m] << (8 * m);
+                row_t[j] |= (unsigned int)diatonic_term(d[j][m]) << (8 * m);
+            }
+        }
+#if defined(__AVX2__)
+        __m256i max_v = _mm256_setzero_si256(), sum_v = _mm256_setzero_si256(), ctl;
+        for (j = 0; j < 4; ++j) {
+            ctl = _mm256_loadu_si256((const __m256i*)sym4_shuffle[j]);
+            max_v = _mm256_max_epu8(max_v, _mm256_shuffle_epi8(_mm256_set1_epi32(row_d[j]), ctl));
+            sum_v = _mm256_add_epi8(sum_v, _mm256_shuffle_epi8(_mm256_set1_epi32(row_t[j]), ctl));
+        }
+        __m256i kv = _mm256_set1_epi8((char)k);
+        __m256i ok = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(max_v, kv), kv),
+                                      _mm256_cmpeq_epi8(sum_v, _mm256_set1_epi8((char)s)));
+        mask = (unsigned int)_mm256_movemask_epi8(ok);
+#else
+        __m128i kv = _mm_set1_epi8((char)k), sv = _mm_set1_epi8((char)s);
+        for (i = 0; i < 2; ++i) {
+            __m128i max_v = _mm_setzero_si128(), sum_v = _mm_setzero_si128(), ctl;
+            for (j = 0; j < 4; ++j) {
+                ctl = _mm_loadu_si128((const __m128i*)(sym4_shuffle[j] + 16 * i));
+                max_v = _mm_max_epu8(max_v, _mm_shuffle_epi8(_mm_set1_epi32(row_d[j]), ctl));
+                sum_v = _mm_add_epi8(sum_v, _mm_shuffle_epi8(_mm_set1_epi32(row_t[j]), ctl));
+            }
+            __m128i ok = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(max_v, kv), kv), _mm_cmpeq_epi8(sum_v, sv));
+            mask |= (unsigned int)_mm_movemask_epi8(ok) << (16 * i);
+        }
+#endif
+        return mask & 0xffffff;
+    }
+#endif
+    for (i = 0; i < 24; ++i) {
+        max_d = sum_t = 0;
+        for (j = 0; j < 4; ++j) {
+            m = d[j][sym4[i][j]];
+            max_d = std::max(max_d, m);
+            sum_t += diatonic_term(m);
+        }
+        if (max_d <= k && sum_t == s)
+            mask |= 1u << i;
+    }
+    return mask;
+}
+
 std::set<Transition> Transition::elementary_transitions(const Chord &c1, const Chord &c2, int k, const Domain &dom, PreparationScheme p, bool aug) {
     std::vector<Realization> br1 = Realization::tonal_realizations(c1, dom, aug);
     std::vector<Realization> br2 = Realization::tonal_realizations(c2, dom, aug);
     std::set<Transition> ret;
     std::vector<int> f(4, -1);
-    int rv1, rv2, sv, i, j, s;
+    int rv1, rv2, sv, i, j, m, d[4][4];
+    unsigned int mask;
     for (std::vector<Realization>::const_iterator it = br1.begin(); it != br1.end(); ++it) {
         rv1 = it->generic_root_voice();
         for (std::vector<Realization>::const_iterator jt = br2.begin(); jt != br2.end(); ++jt) {
             rv2 = jt->generic_root_voice();
-            for (i = 0; i < 24; ++i) {
-                s = 0;
-                for (j = 0; j < 4; ++j) {
-                    f[j] = sym4[i][j];
-                    if (Tone::lof_distance(it->tone(j), jt->tone(f[j])) > k)
-                        break;
-                    s += Tone::modd(3 * Tone::lof_distance(it->tone(j), jt->tone(f[j])), 7);
+            for (j = 0; j < 4; ++j) {
+                for (m = 0; m < 4; ++m) {
+                    d[j][m] = Tone::lof_distance(it->tone(j), jt->tone(m));
                 }
-                if (j == 4 && s == Tone::modd(2 * Tone::lof_distance(it->tone(rv1), jt->tone(rv2)), 7)) {
+            }
+            mask = sym4_mask(d, k, Tone::modd(2 * d[rv1][rv2], 7));
+            for (i = 0; i < 24; ++i) {
+                if (mask & (1u << i)) {
+                    for (j = 0; j < 4; ++j) {
+                        f[j] = sym4[i][j];
+                    }
                     Realization r1(*it), r2(*jt);
                     r2.arrange(f);
                     Transition T(r1, r2);
@@ -531,6 +630,7 @@ std::set<Transition> Transition::elementary_transitions(const Chord &c1, const C
             }
         }
     }
+    Profile::count(PROFILE_TRANSITIONS_GENERATED, ret.size());
     return ret;
 }
 
@@ -557,12 +657,14 @@ std::vector<Transition> Transition::elementary_classes(const Chord &c1, const Ch
             }
         } else ret.push_back(*it);
     }
+    Profile::count(PROFILE_TRANSITIONS_DEDUPLICATED, E.size() - ret.size());
     std::sort(ret.begin(), ret.end());
     return ret;
 }
 
 std::vector<Transition> Transition::elementary_types(const std::vector<Chord> &chords, int k, PreparationScheme p,
                                                      int z, bool aug, bool respell_aug, bool favor_diatonic) {
+    Profile::Timer timer("Transition::elementary_types");
     std::vector<Chord>::const_iterator it, jt;
     std::vector<Transition>::const_iterator kt, st;
     std::vector<Transition> cls;
@@ -610,6 +712,7 @@ std::vector<Transition> Transition::elementary_types(const std::vector<Chord> &c
                     }
                 }
                 if (found) {
+                    Profile::count(PROFILE_TRANSITIONS_DEDUPLICATED);
                     if (kt->is_closer_than(*st, z)) {
                         cls.erase(st);
                         cls.push_back(*kt);
@@ -204,6 +204,16 @@ public:
     static void simplify_enharmonic_classes(std::vector<Transition> &cl, bool respell_aug, bool favor_diatonic);
     /* a convenience routine */
 
+    static int sym4_index(const std::vector<int> &f);
+    /* returns the index of permutation f in sym4 */
+
+    static unsigned int sym4_mask(const int d[4][4], int k, int s);
+    /* returns the mask in which the i-th bit is set iff the permutation f = sym4[i] satisfies d[j][f[j]] <= k for
+     * all j and the sum of Tone::modd(3*d[j][f[j]],7) over j equals s, where d is a matrix of nonnegative
+     * distances on the line of fifths (i.e. iff f yields an elementary transition of class k, see above)
+     *  - the permutations are tested at once with AVX2 or SSSE3 instructions, if enabled at compile time
+     */
+
     static const int sym4[][4];
     static const char* chord_type_names[];
 };
@@ -19,62 +19,86 @@
  */
 
 #include "transitionnetwork.h"
+#include "profile.h"
 #include <assert.h>
 #include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <queue>
+#include <thread>
 
 TransitionNetwork::TransitionNetwork(const ChordGraph &cg, const ivector &walk, const Realization &r, const std::vector<double> &wgh, int z) :
     Digraph(true, false)
 {
+    Profile::Timer timer("TransitionNetwork::TransitionNetwork");
     X0 = r;
+    M = cg.class_index();
     nl = walk.size() - 1;
     _num_paths = 1;
+    _log_num_paths = 0;
     glp_vertex *v, *w;
     glp_arc *a;
-    int mc, l, vi, i, j, tcn, d = 1;
-    ivector f;
-    std::map<int,ivector> levels;
-    /* create vertices, arranged in levels */
+    int mc, l, vi, i, j, n1, n2, x0 = nl > 0 ? cg.predecessor_index(walk[0], X0) : -1;
+    ivector f, tcn0;
+    _level_start.resize(nl + 1, 0);
+    _trans.push_back(NULL);
+    _vertex_level.push_back(0);
+    /* create vertices, arranged in levels (the last level comes first) */
     for (l = nl; l-->0;) {
-        i = walk[l];
-        j = walk[l+1];
-        a = cg.arc(i, j);
+        a = cg.arc(walk[l], walk[l+1]);
         assert(a != NULL);
         const std::set<Transition> &ta = cg.transitions(a);
         vi = add_vertices(ta.size());
-        _num_paths *= ta.size();
+        Profile::count(PROFILE_NETWORK_VERTICES, ta.size());
+        _num_paths = _num_paths > ULLONG_MAX / ta.size() ? ULLONG_MAX : _num_paths * ta.size();
+        _log_num_paths += log((double)ta.size());
+        _level_start[l+1] = vi;
         for (std::set<Transition>::const_iterator it = ta.begin(); it != ta.end(); ++it) {
-            transition_map[vi] = &(*it);
-            levels[l+1].push_back(vi);
-            ++vi;
+            _trans.push_back(&(*it));
+            _vertex_level.push_back(l+1);
+        }
+    }
+    /* create arcs between levels */
+    _arc_offset.resize(nl + 1, 0);
+    for (l = 1; l < nl; ++l) {
+        n1 = level_size(l);
+        n2 = level_size(l+1);
+        _arc_offset[l+1] = _arc_offset[l] + n1 * n2;
+    }
+    _phi.resize(_arc_offset[nl]);
+    _cues.resize(_arc_offset[nl]);
+    /* the voice leadings from X0 to the first level are looked up in the glue table if X0 is a tonal realization */
+    if (nl > 1) {
+        n1 = level_size(1);
+        tcn0.resize(n1);
+        for (i = 0; i < n1; ++i) {
+            if (x0 >= 0)
+                tcn0[i] = cg.glue_table(walk[0], walk[1]).row(x0)[i].tcn;
+            else assert(_trans[_level_start[1] + i]->glue(X0, mc, tcn0[i], f));
         }
     }
-    /* create edges between levels */
     for (l = 1; l < nl; ++l) {
-        ivector &lev1 = levels[l], &lev2 = levels[l+1];
-        for (ivector::const_iterator it = lev1.begin(); it != lev1.end(); ++it) {
-            v = vertex(*it);
-            const Transition &t1 = *(transition_map.at(*it));
-            for (ivector::const_iterator jt = lev2.begin(); jt != lev2.end(); ++jt) {
-                w = vertex(*jt);
-                const Transition &t2 = *(transition_map.at(*jt));
-                assert(t2.glue(t1.second(), mc, tcn, f, cg.class_index()));
+        n1 = level_size(l);
+        n2 = level_size(l+1);
+        const ChordGraph::GlueTable &gt1 = cg.glue_table(walk[l-1], walk[l]), &gt2 = cg.glue_table(walk[l], walk[l+1]);
+        for (i = 0; i < n1; ++i) {
+            v = vertex(_level_start[l] + i);
+            const Transition &t1 = *_trans[v->i];
+            const ChordGraph::GlueTable::entry *row = gt2.row(gt1.target(i));
+            for (j = 0; j < n2; ++j) {
+                w = vertex(_level_start[l+1] + j);
+                const Transition &t2 = *_trans[w->i];
                 a = add_arc(v->i, w->i);
-                phi_map[a] = f;
-                cues_map[a] = mc > 0;
+                Profile::count(PROFILE_NETWORK_ARCS);
+                _phi[_arc_offset[l] + i * n2 + j] = row[j].phi;
+                _cues[_arc_offset[l] + i * n2 + j] = row[j].mc > 0;
                 /* compute the arc weight */
-                double wg = wgh[0] * t2.second().lof_point_distance(z) / d + sqrt(tcn / 4) * wgh[1] / d;
-                if (t2.second().is_augmented_sixth())
-                    wg += wgh[2];
-                if (l == 1) {
-                    assert(t1.glue(X0, mc, tcn, f));
-                    wg += wgh[0] * X0.lof_point_distance(z) / d;
-                    wg += wgh[0] * t1.second().lof_point_distance(z) / d + sqrt(tcn / 4) * wgh[1] / d;
-                    if (t1.second().is_augmented_sixth())
-                        wg += wgh[2];
-                    if (X0.is_augmented_sixth())
-                        wg += wgh[2];
-                }
-                arc_data(a)->weight = wg;
+                if (l == 1)
+                    arc_data(a)->weight = first_arc_weight(X0, t1, tcn0[i], t2, row[j].tcn, wgh, z);
+                else arc_data(a)->weight = arc_weight(t2, row[j].tcn, wgh, z);
             }
         }
     }
@@ -100,10 +124,19 @@ int TransitionNetwork::num_levels() const {
     return nl;
 }
 
-int TransitionNetwork::num_paths() const {
+unsigned long long TransitionNetwork::num_paths() const {
     return _num_paths;
 }
 
+double TransitionNetwork::log_num_paths() const {
+    return _log_num_paths;
+}
+
+int TransitionNetwork::level_size(int l) const {
+    assert(l > 0 && l <= nl);
+    return (l == 1 ? number_of_vertices() + 1 : _level_start[l-1]) - _level_start[l];
+}
+
 ivector TransitionNetwork::best_path(bool use_dijkstra) {
     ivector bp, p;
     double w, min_weight = 0;
@@ -145,15 +178,18 @@ std::vector<ivector> TransitionNetwork::best_paths(double &theta) {
     return ret;
 }
 
+int TransitionNetwork::arc_index(int i, int j) const {
+    int l = _vertex_level[i];
+    assert(l < nl && _vertex_level[j] == l + 1);
+    return _arc_offset[l] + (i - _level_start[l]) * level_size(l+1) + j - _level_start[l+1];
+}
+
 voicing TransitionNetwork::realize_path(const ivector &path) {
-    glp_vertex *v, *w;
-    glp_arc *a;
-    int n = path.size(), mc, tcn;
+    int n = path.size(), mc, tcn, k;
     ivector f(4), f0;
     voicing ret;
     for (int i = 0; i < n; ++i) {
-        v = vertex(path[i]);
-        const Transition &t = *(transition_map.at(v->i));
+        const Transition &t = *_trans[path[i]];
         Realization r1 = t.first(), r2 = t.second();
         if (i == 0)
             assert(t.glue(X0, mc, tcn, f, M));
@@ -166,17 +202,10 @@ voicing TransitionNetwork::realize_path(const ivector &path) {
         }
         ret.push_back(std::make_pair(r2, false));
         if (i != n - 1) {
-            w = vertex(path[i+1]);
-            a = v->out;
-            while (a != NULL) {
-                if (a->head == w) break;
-                a = a->t_next;
-            }
-            assert(a != NULL);
-            f = compose(f, phi_map.at(a));
-            if (cues_map.at(a)) {
-                const Transition &u = *(transition_map.at(w->i));
-                Realization r = u.first();
+            k = arc_index(path[i], path[i+1]);
+            f = compose(f, ivector(Transition::sym4[_phi[k]], Transition::sym4[_phi[k]] + 4));
+            if (_cues[k]) {
+                Realization r = _trans[path[i+1]]->first();
                 r.arrange(f);
                 ret.push_back(std::make_pair(r, true));
             }
@@ -185,6 +214,338 @@ voicing TransitionNetwork::realize_path(const ivector &path) {
     return ret;
 }
 
+double TransitionNetwork::arc_weight(const Transition &t, int tcn, const std::vector<double> &wgh, int z) {
+    double wg = wgh[0] * t.second().lof_point_distance(z) + sqrt(tcn / 4) * wgh[1];
+    if (t.second().is_augmented_sixth())
+        wg += wgh[2];
+    return wg;
+}
+
+double TransitionNetwork::first_arc_weight(const Realization &X0, const Transition &t1, int tcn1,
+                                           const Transition &t2, int tcn2, const std::vector<double> &wgh, int z) {
+    double wg = arc_weight(t2, tcn2, wgh, z);
+    wg += wgh[0] * X0.lof_point_distance(z);
+    wg += wgh[0] * t1.second().lof_point_distance(z) + sqrt(tcn1 / 4) * wgh[1];
+    if (t1.second().is_augmented_sixth())
+        wg += wgh[2];
+    if (X0.is_augmented_sixth())
+        wg += wgh[2];
+    return wg;
+}
+
+double TransitionNetwork::initial_weight(const Realization &X0, const Transition *t1, int tcn1, const std::vector<double> &wgh, int z) {
+    double wg = wgh[0] * X0.lof_point_distance(z);
+    if (X0.is_augmented_sixth())
+        wg += wgh[2];
+    if (t1 != NULL) {
+        wg += wgh[0] * t1->second().lof_point_distance(z) + sqrt(tcn1 / 4) * wgh[1];
+        if (t1->second().is_augmented_sixth())
+            wg += wgh[2];
+    }
+    return wg;
+}
+
+void TransitionNetwork::realize(const ChordGraph &cg, const std::vector<const ChordGraph::GlueTable*> &gt,
+                                const Realization &r, const ivector &path, voicing &v) {
+    int nl = path.size() - 1, M = cg.class_index(), l, mc, tcn;
+    ivector f, phi;
+    v.clear();
+    for (l = 1; l <= nl; ++l) {
+        const Transition &t = gt[l]->transition(path[l]);
+        if (l == 1)
+            assert(t.glue(r, mc, tcn, f, M));
+        else {
+            const ChordGraph::GlueTable::entry &e = gt[l]->row(gt[l-1]->target(path[l-1]))[path[l]];
+            phi.assign(Transition::sym4[e.phi], Transition::sym4[e.phi] + 4);
+            f = compose(f, phi);
+            mc = e.mc;
+        }
+        if (l == 1)
+            v.push_back(std::make_pair(r, false));
+        if (mc > 0) {
+            Realization r1 = t.first();
+            r1.arrange(f);
+            v.push_back(std::make_pair(r1, true));
+        }
+        Realization r2 = t.second();
+        r2.arrange(f);
+        v.push_back(std::make_pair(r2, false));
+    }
+}
+
+std::shared_ptr<const TransitionNetwork::Frontier> TransitionNetwork::first_frontier(const ChordGraph &cg, const ivector &walk,
+                                                                                     const Realization &r) {
+    assert(walk.size() > 1);
+    const ChordGraph::GlueTable &gt = cg.glue_table(walk[0], walk[1]);
+    int n = gt.size(), x0 = cg.predecessor_index(walk[0], r), mc;
+    ivector f;
+    std::shared_ptr<Frontier> ret = std::make_shared<Frontier>();
+    ret->level = 1;
+    ret->glue = &gt;
+    ret->cost.assign(n, 0);
+    ret->src.resize(n);
+    ret->tcn0.resize(n);
+    for (int i = 0; i < n; ++i) {
+        if (x0 >= 0)
+            ret->tcn0[i] = gt.row(x0)[i].tcn;
+        else assert(gt.transition(i).glue(r, mc, ret->tcn0[i], f));
+        ret->src[i] = i;
+    }
+    return ret;
+}
+
+/* The vertices of the network are processed level by level in the order of their indices in the network.
+ * Among the cheapest paths to a vertex, the one starting at the earliest source is kept, and then the one
+ * whose predecessor is the closest to the source, which is the choice that Dijkstra's algorithm makes
+ * in best_path. */
+std::shared_ptr<const TransitionNetwork::Frontier> TransitionNetwork::next_frontier(const ChordGraph &cg, const ivector &walk,
+                                                                                    const Realization &r, const std::vector<double> &wgh,
+                                                                                    int z, const std::shared_ptr<const Frontier> &prev) {
+    int l = prev->level, n1, n2, i, j, p, tcn;
+    assert(l + 1 < (int)walk.size());
+    const ChordGraph::GlueTable &gt1 = *prev->glue, &gt2 = cg.glue_table(walk[l], walk[l+1]);
+    const std::vector<double> &cost = prev->cost;
+    const ivector &src = prev->src;
+    double c;
+    n1 = gt1.size();
+    n2 = gt2.size();
+    std::shared_ptr<Frontier> ret = std::make_shared<Frontier>();
+    ret->level = l + 1;
+    ret->glue = &gt2;
+    ret->cost.assign(n2, DBL_MAX);
+    ret->src.assign(n2, -1);
+    ret->parent.assign(n2, -1);
+    ret->prev = prev;
+    std::vector<double> &next_cost = ret->cost;
+    ivector &next_src = ret->src, &parent = ret->parent;
+    for (i = 0; i < n1; ++i) {
+        const Transition &t1 = gt1.transition(i);
+        const ChordGraph::GlueTable::entry *row = gt2.row(gt1.target(i));
+        for (j = 0; j < n2; ++j) {
+            const Transition &t2 = gt2.transition(j);
+            tcn = row[j].tcn;
+            c = cost[i] + (l == 1 ? first_arc_weight(r, t1, prev->tcn0[i], t2, tcn, wgh, z) : arc_weight(t2, tcn, wgh, z));
+            p = parent[j];
+            if (p < 0 || c < next_cost[j] ||
+                    (c == next_cost[j] && (src[i] < next_src[j] || (src[i] == next_src[j] && cost[i] < cost[p])))) {
+                next_cost[j] = c;
+                next_src[j] = src[i];
+                parent[j] = i;
+            }
+        }
+    }
+    return ret;
+}
+
+double TransitionNetwork::finish(const ChordGraph &cg, const ivector &walk, const Realization &r,
+                                 const std::vector<double> &wgh, int z, const Frontier &last, voicing &v) {
+    int nl = walk.size() - 1, l, j, n = last.cost.size(), best = 0;
+    assert(last.level == nl);
+    std::vector<double> initial;
+    if (nl == 1) {
+        initial.resize(n);
+        for (j = 0; j < n; ++j) {
+            initial[j] = initial_weight(r, &last.glue->transition(j), last.tcn0[j], wgh, z);
+        }
+    }
+    const std::vector<double> &cost = nl == 1 ? initial : last.cost;
+    for (j = 1; j < n; ++j) {
+        if (cost[j] < cost[best] || (cost[j] == cost[best] && last.src[j] < last.src[best]))
+            best = j;
+    }
+    std::vector<const ChordGraph::GlueTable*> gt(nl + 1);
+    ivector path(nl + 1);
+    path[nl] = best;
+    const Frontier *fr = &last;
+    for (l = nl; l >= 1; --l) {
+        gt[l] = fr->glue;
+        if (l > 1)
+            path[l-1] = fr->parent[path[l]];
+        fr = fr->prev.get();
+    }
+    realize(cg, gt, r, path, v);
+    return cost[best];
+}
+
+double TransitionNetwork::solve(const ChordGraph &cg, const ivector &walk, const Realization &r,
+                                const std::vector<double> &wgh, int z, voicing &v) {
+    int nl = walk.size() - 1;
+    v.clear();
+    if (nl == 0) {
+        v.push_back(std::make_pair(r, false));
+        return initial_weight(r, NULL, 0, wgh, z);
+    }
+    std::shared_ptr<const Frontier> fr = first_frontier(cg, walk, r);
+    for (int l = 1; l < nl; ++l) {
+        fr = next_frontier(cg, walk, r, wgh, z, fr);
+    }
+    return finish(cg, walk, r, wgh, z, *fr, v);
+}
+
+/* A partial path in the K-best search, given by its weight, the source in which it starts and the weight
+ * of its prefix, which is the rank-th cheapest partial path to the parent vertex in the preceding level.
+ * The order of partial paths extends the tie-breaking rules of solve, hence the cheapest path is the same.
+ * Partial paths which yield the same partial voicing have the same signature (see voicing_signatures). */
+struct kbest_entry {
+    double cost;
+    int src;
+    double pred_cost;
+    int parent;
+    int rank;
+    int sig;
+    kbest_entry(double c, int s, double pc, int p, int r) : cost(c), src(s), pred_cost(pc), parent(p), rank(r), sig(-1) { }
+    bool operator <(const kbest_entry &other) const {
+        if (cost != other.cost)
+            return cost < other.cost;
+        if (src != other.src)
+            return src < other.src;
+        if (pred_cost != other.pred_cost)
+            return pred_cost < other.pred_cost;
+        if (parent != other.parent)
+            return parent < other.parent;
+        return rank < other.rank;
+    }
+};
+
+/* Realizations are compared by their tone sets, hence a voicing is determined by the tone sets of its
+ * realizations and cues. Many paths in a transition network differ only in the assignment of voices
+ * and yield the same voicing; they are recognized by interning the partial voicings. */
+class voicing_signatures {
+    std::map<std::set<Tone>,int> _sets;
+    std::map<std::pair<int,ipair>,int> _sigs;
+
+public:
+    int set_id(const Realization &r) {
+        return _sets.insert(std::make_pair(r.tone_set(), (int)_sets.size())).first->second;
+    }
+    /* returns the signature of the partial voicing sig followed by the cue with tone set id cue (or no cue,
+     * if cue = -1) and the realization with tone set id target */
+    int extend(int sig, int cue, int target) {
+        return _sigs.insert(std::make_pair(std::make_pair(sig, std::make_pair(cue, target)), (int)_sigs.size())).first->second;
+    }
+};
+
+static bool kbest_greater(const kbest_entry &a, const kbest_entry &b) {
+    return b < a;
+}
+
+/* For each vertex, the k cheapest partial paths with distinct partial voicings are kept. They are among
+ * the extensions of those kept for the vertices in the preceding level, since the extensions along an arc
+ * of partial paths with distinct partial voicings are distinct. The latter are sorted, so they are merged
+ * lazily with a heap which holds the cheapest unused extension for each predecessor, hence the work per
+ * vertex is proportional to the number of its predecessors plus k times a logarithm of that number.
+ * The first path taken from each predecessor is its cheapest one, as in the other overload.
+ * Paths ending in different vertices may still yield the same voicing. */
+void TransitionNetwork::solve(const ChordGraph &cg, const ivector &walk, const Realization &r,
+                              const std::vector<double> &wgh, int z, int k, std::vector<std::pair<double,voicing> > &vs) {
+    assert(k > 0);
+    int nl = walk.size() - 1, l, i, j, n1, n2, mc, x0, rank, cue;
+    ivector f;
+    vs.clear();
+    if (nl == 0) {
+        vs.push_back(std::make_pair(initial_weight(r, NULL, 0, wgh, z), voicing(1, std::make_pair(r, false))));
+        return;
+    }
+    std::vector<const ChordGraph::GlueTable*> gt(nl + 1);
+    for (l = 1; l <= nl; ++l) {
+        gt[l] = &cg.glue_table(walk[l-1], walk[l]);
+    }
+    /* the k cheapest partial paths to each vertex in each level */
+    std::vector<std::vector<std::vector<kbest_entry> > > lst(nl + 1);
+    voicing_signatures vsig;
+    std::vector<ivector> first_id(nl + 1), second_id(nl + 1);
+    for (l = 1; l <= nl; ++l) {
+        for (j = 0; j < gt[l]->size(); ++j) {
+            first_id[l].push_back(vsig.set_id(gt[l]->transition(j).first()));
+            second_id[l].push_back(vsig.set_id(gt[l]->transition(j).second()));
+        }
+    }
+    n1 = gt[1]->size();
+    ivector tcn0(n1);
+    x0 = cg.predecessor_index(walk[0], r);
+    lst[1].resize(n1);
+    for (i = 0; i < n1; ++i) {
+        if (x0 >= 0) {
+            tcn0[i] = gt[1]->row(x0)[i].tcn;
+            mc = gt[1]->row(x0)[i].mc;
+        } else assert(gt[1]->transition(i).glue(r, mc, tcn0[i], f));
+        lst[1][i].push_back(kbest_entry(0, i, 0, -1, 0));
+        lst[1][i].back().sig = vsig.extend(-1, mc > 0 ? first_id[1][i] : -1, second_id[1][i]);
+    }
+    std::vector<const ChordGraph::GlueTable::entry*> rows;
+    std::vector<double> w;
+    std::vector<kbest_entry> heap;
+    for (l = 1; l < nl; ++l) {
+        n1 = gt[l]->size();
+        n2 = gt[l+1]->size();
+        lst[l+1].resize(n2);
+        rows.resize(n1);
+        w.resize(n1);
+        for (i = 0; i < n1; ++i) {
+            rows[i] = gt[l+1]->row(gt[l]->target(i));
+        }
+        for (j = 0; j < n2; ++j) {
+            const Transition &t2 = gt[l+1]->transition(j);
+            heap.clear();
+            for (i = 0; i < n1; ++i) {
+                int tcn = rows[i][j].tcn;
+                w[i] = l == 1 ? first_arc_weight(r, gt[l]->transition(i), tcn0[i], t2, tcn, wgh, z) : arc_weight(t2, tcn, wgh, z);
+                const kbest_entry &e = lst[l][i].front();
+                heap.push_back(kbest_entry(e.cost + w[i], e.src, e.cost, i, 0));
+            }
+            std::vector<kbest_entry> &next = lst[l+1][j];
+            std::make_heap(heap.begin(), heap.end(), kbest_greater);
+            while (!heap.empty() && (int)next.size() < k) {
+                std::pop_heap(heap.begin(), heap.end(), kbest_greater);
+                kbest_entry &e = heap.back();
+                i = e.parent;
+                cue = rows[i][j].mc > 0 ? first_id[l+1][j] : -1;
+                e.sig = vsig.extend(lst[l][i][e.rank].sig, cue, second_id[l+1][j]);
+                bool dup = false;
+                for (std::vector<kbest_entry>::const_iterator it = next.begin(); !dup && it != next.end(); ++it) {
+                    dup = it->sig == e.sig;
+                }
+                if (!dup)
+                    next.push_back(e);
+                rank = e.rank + 1;
+                heap.pop_back();
+                if (rank < (int)lst[l][i].size()) {
+                    const kbest_entry &pe = lst[l][i][rank];
+                    heap.push_back(kbest_entry(pe.cost + w[i], pe.src, pe.cost, i, rank));
+                    std::push_heap(heap.begin(), heap.end(), kbest_greater);
+                }
+            }
+        }
+    }
+    /* choose the k cheapest complete paths with distinct voicings */
+    n2 = gt[nl]->size();
+    std::vector<kbest_entry> sinks;
+    for (j = 0; j < n2; ++j) {
+        for (rank = 0; rank < (int)lst[nl][j].size(); ++rank) {
+            const kbest_entry &e = lst[nl][j][rank];
+            sinks.push_back(kbest_entry(nl == 1 ? initial_weight(r, &gt[1]->transition(j), tcn0[j], wgh, z) : e.cost,
+                                        e.src, 0, j, rank));
+            sinks.back().sig = e.sig;
+        }
+    }
+    std::sort(sinks.begin(), sinks.end());
+    std::set<int> sigs;
+    ivector path(nl + 1);
+    for (std::vector<kbest_entry>::const_iterator it = sinks.begin(); it != sinks.end() && (int)vs.size() < k; ++it) {
+        if (!sigs.insert(it->sig).second)
+            continue;
+        path[nl] = it->parent;
+        rank = it->rank;
+        for (l = nl; l > 1; --l) {
+            const kbest_entry &e = lst[l][path[l]][rank];
+            path[l-1] = e.parent;
+            rank = e.rank;
+        }
+        vs.push_back(std::make_pair(it->cost, voicing()));
+        realize(cg, gt, r, path, vs.back().second);
+    }
+}
+
 ivector TransitionNetwork::compose(const ivector &f1, const ivector &f2) {
     assert(f1.size() == 4 && f2.size() == 4);
     ivector tmp(4);
@@ -194,16 +555,101 @@ ivector TransitionNetwork::compose(const ivector &f1, const ivector &f2) {
     return tmp;
 }
 
+/* The weight of a path for the center of gravity z is at least the spread (and the augmented-sixth penalty)
+ * of the initial realization plus, for each level, the least such term among its transitions and the least
+ * voice-leading term among its arcs. The bounds for the levels are computed here for each z in the support. */
+void TransitionNetwork::level_bounds(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh,
+                                     std::vector<double> &lb) {
+    const Domain &dom = cg.support();
+    int nz = dom.ubound() - dom.lbound() + 1, nl = walk.size() - 1, l, k, x, z, np;
+    double d;
+    lb.assign(nz, 0);
+    std::vector<double> min_d(nz);
+    for (l = 1; l <= nl; ++l) {
+        const ChordGraph::GlueTable &gt = cg.glue_table(walk[l-1], walk[l]);
+        int min_tcn = INT_MAX;
+        np = cg.predecessors(walk[l-1]).size();
+        for (x = 0; x < np; ++x) {
+            const ChordGraph::GlueTable::entry *row = gt.row(x);
+            for (k = 0; k < gt.size(); ++k) {
+                min_tcn = std::min(min_tcn, (int)row[k].tcn);
+            }
+        }
+        min_d.assign(nz, DBL_MAX);
+        for (k = 0; k < gt.size(); ++k) {
+            const Realization &r = gt.transition(k).second();
+            for (z = 0; z < nz; ++z) {
+                d = wgh[0] * r.lof_point_distance(dom.lbound() + z);
+                if (r.is_augmented_sixth())
+                    d += wgh[2];
+                min_d[z] = std::min(min_d[z], d);
+            }
+        }
+        for (z = 0; z < nz; ++z) {
+            lb[z] += min_d[z] + sqrt(min_tcn / 4) * wgh[1];
+        }
+    }
+}
+
+/* With nonnegative weights, the pairs (X0,z) are tried in the order of increasing lower bounds on the weight
+ * of their best path, and the search stops when the bound exceeds the weight of the best path found so far.
+ * Ties are resolved in favor of the pair which comes first in the order of the exhaustive search,
+ * so the result is the same as without pruning. The bounds are slightly relaxed to absorb rounding errors. */
+int TransitionNetwork::find_voicing(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh, voicing &v,
+                                    const std::function<double(const Realization&,int,voicing&)> &solver) {
+    Profile::Timer timer("TransitionNetwork::find_voicing");
+    const Chord &c0 = cg.vertex2chord(walk.front());
+    Domain dom = cg.support();
+    double w, min_w = 0;
+    int best_z = 0, nz = dom.ubound() - dom.lbound() + 1, best_order = -1, order;
+    std::vector<Realization> R = Realization::tonal_realizations(c0, dom, cg.allows_augmented_sixths());
+    bool prune = wgh[0] >= 0 && wgh[1] >= 0 && wgh[2] >= 0;
+    std::vector<double> lb;
+    std::vector<std::pair<double,int> > cand;
+    level_bounds(cg, walk, wgh, lb);
+    for (int i = 0; i < (int)R.size(); ++i) {
+        for (int z = 0; z < nz; ++z) {
+            w = lb[z] + initial_weight(R[i], NULL, 0, wgh, dom.lbound() + z);
+            cand.push_back(std::make_pair(prune ? w * (1.0 - 1e-9) : 0.0, i * nz + z));
+        }
+    }
+    std::sort(cand.begin(), cand.end());
+    voicing sv;
+    for (std::vector<std::pair<double,int> >::const_iterator it = cand.begin(); it != cand.end(); ++it) {
+        if (prune && best_order >= 0 && it->first > min_w) {
+            Profile::count(PROFILE_VOICING_CANDIDATES_PRUNED, cand.end() - it);
+            break;
+        }
+        order = it->second;
+        w = solver(R[order / nz], dom.lbound() + order % nz, sv);
+        /* short walks may have paths of zero weight */
+        if (best_order < 0 || w < min_w || (w == min_w && order < best_order)) {
+            v = sv;
+            min_w = w;
+            best_order = order;
+            best_z = dom.lbound() + order % nz;
+        }
+    }
+    arrange_voices(v);
+    return best_z;
+}
+
 int TransitionNetwork::find_voicing(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh, voicing &v, bool best) {
+    if (best) {
+        return find_voicing(cg, walk, wgh, v, [&](const Realization &r, int z, voicing &sv) {
+            return solve(cg, walk, r, wgh, z, sv);
+        });
+    }
+    Profile::Timer timer("TransitionNetwork::find_voicing");
     const Chord &c0 = cg.vertex2chord(walk.front());
     Domain dom = cg.support();
     double w, min_w = 0;
-    int best_z;
+    int best_z = 0;
     std::vector<Realization> R = Realization::tonal_realizations(c0, dom, cg.allows_augmented_sixths());
     for (std::vector<Realization>::const_iterator it = R.begin(); it != R.end(); ++it) {
         for (int z = dom.lbound(); z <= dom.ubound(); ++z) {
             TransitionNetwork tn(cg, walk, *it, wgh, z);
-            ivector bp = best ? tn.best_path() : tn.worst_path();
+            ivector bp = tn.worst_path();
             w = tn.path_weight(bp);
             if (min_w == 0 || w < min_w) {
                 v = tn.realize_path(bp);
@@ -216,6 +662,263 @@ int TransitionNetwork::find_voicing(const ChordGraph &cg, const ivector &walk, c
     return best_z;
 }
 
+/* The pairs (X0,z) are tried in the same order as in find_voicing and the k best voicings are found
+ * for each of them. The same voicing may occur for several centers of gravity, in which case the weight
+ * of its cheapest path is kept. The search stops when the lower bound exceeds the weight of the k-th best
+ * voicing found so far. Ties are resolved in favor of the path found first in the exhaustive search,
+ * hence the first voicing is the one returned by find_voicing. */
+std::vector<std::pair<double,voicing> > TransitionNetwork::find_best_voicings(const ChordGraph &cg, const ivector &walk,
+                                                                             const std::vector<double> &wgh, int k) {
+    Profile::Timer timer("TransitionNetwork::find_best_voicings");
+    assert(k > 0);
+    const Chord &c0 = cg.vertex2chord(walk.front());
+    Domain dom = cg.support();
+    double w, kth_w = DBL_MAX;
+    int nz = dom.ubound() - dom.lbound() + 1, order, rank;
+    std::vector<Realization> R = Realization::tonal_realizations(c0, dom, cg.allows_augmented_sixths());
+    bool prune = wgh[0] >= 0 && wgh[1] >= 0 && wgh[2] >= 0;
+    std::vector<double> lb, costs;
+    std::vector<std::pair<double,int> > cand;
+    level_bounds(cg, walk, wgh, lb);
+    for (int i = 0; i < (int)R.size(); ++i) {
+        for (int z = 0; z < nz; ++z) {
+            w = lb[z] + initial_weight(R[i], NULL, 0, wgh, dom.lbound() + z);
+            cand.push_back(std::make_pair(prune ? w * (1.0 - 1e-9) : 0.0, i * nz + z));
+        }
+    }
+    std::sort(cand.begin(), cand.end());
+    /* the weight and the position (order, rank) of the cheapest path found so far for each voicing */
+    std::vector<std::pair<std::pair<double,ipair>,voicing> > found;
+    std::map<voicing,int> index;
+    std::vector<std::pair<double,voicing> > vs;
+    for (std::vector<std::pair<double,int> >::const_iterator it = cand.begin(); it != cand.end(); ++it) {
+        if (it->first > kth_w) {
+            Profile::count(PROFILE_VOICING_CANDIDATES_PRUNED, cand.end() - it);
+            break;
+        }
+        order = it->second;
+        solve(cg, walk, R[order / nz], wgh, dom.lbound() + order % nz, k, vs);
+        for (rank = 0; rank < (int)vs.size(); ++rank) {
+            std::pair<double,ipair> pos = std::make_pair(vs[rank].first, std::make_pair(order, rank));
+            std::map<voicing,int>::const_iterator jt = index.find(vs[rank].second);
+            if (jt == index.end()) {
+                index[vs[rank].second] = found.size();
+                found.push_back(std::make_pair(pos, vs[rank].second));
+            } else if (pos < found[jt->second].first)
+                found[jt->second] = std::make_pair(pos, vs[rank].second);
+        }
+        if (prune && (int)found.size() >= k) {
+            costs.clear();
+            for (std::vector<std::pair<std::pair<double,ipair>,voicing> >::const_iterator jt = found.begin(); jt != found.end(); ++jt) {
+                costs.push_back(jt->first.first);
+            }
+            std::nth_element(costs.begin(), costs.begin() + k - 1, costs.end());
+            kth_w = costs[k-1];
+        }
+    }
+    std::sort(found.begin(), found.end());
+    std::vector<std::pair<double,voicing> > ret;
+    for (int i = 0; i < (int)found.size() && i < k; ++i) {
+        ret.push_back(std::make_pair(found[i].first.first, found[i].second));
+        arrange_voices(ret.back().second);
+    }
+    return ret;
+}
+
+/* A pair (X0,z) in the search for near-optimal voicings, along with the least weight of a completion
+ * from each vertex of the network (the backward potentials). */
+struct near_optimal_candidate {
+    Realization r;
+    int z;
+    int root;                                   // the signature of the partial voicing consisting of r
+    ivector tcn0;                               // the taxicab norms from r via the first transitions
+    ivector mc0;                                // the numbers of cues from r via the first transitions
+    std::vector<std::vector<double> > h;        // h[l][i] is the least weight of a completion from the vertex i in level l
+};
+
+/* A partial path in the search for near-optimal voicings, which is stored with a pointer to its prefix. */
+struct near_optimal_node {
+    double cost;
+    int cand;
+    int level;
+    int vertex;
+    int sig;
+    int parent;
+};
+
+/* The weight of a path is the sum of the weights of its arcs, where the arcs from the first level account
+ * for X0 and the first transition (if the walk has only two chords, the weight is given by initial_weight).
+ * For each pair (X0,z) whose lower bound does not exceed the tolerance threshold, the backward potentials
+ * are computed in a single pass from the last level. Then the partial paths of all pairs are expanded
+ * in the order of the sum of their weight and the potential of their last vertex, which is the weight of
+ * their cheapest completion, hence complete paths are obtained in increasing order of weight and an arc is
+ * pruned as soon as its cheapest completion exceeds the threshold. A partial path is dropped if a path
+ * with the same partial voicing has already been expanded from the same vertex, since it cannot lead
+ * to a voicing which is not found otherwise, or to a cheaper one. The threshold is slightly relaxed
+ * to absorb rounding errors. */
+unsigned long long TransitionNetwork::find_near_optimal_voicings(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh,
+                                                                 double eps, bool relative,
+                                                                 const std::function<bool(double,const voicing&)> &f) {
+    Profile::Timer timer("TransitionNetwork::find_near_optimal_voicings");
+    assert(eps >= 0);
+    const Chord &c0 = cg.vertex2chord(walk.front());
+    Domain dom = cg.support();
+    int nz = dom.ubound() - dom.lbound() + 1, nl = walk.size() - 1, l, i, j, n1, n2, order, cue;
+    double w, theta = DBL_MAX, thres = DBL_MAX;
+    unsigned long long count = 0;
+    ivector f0;
+    std::vector<Realization> R = Realization::tonal_realizations(c0, dom, cg.allows_augmented_sixths());
+    bool prune = wgh[0] >= 0 && wgh[1] >= 0 && wgh[2] >= 0;
+    std::vector<double> lb;
+    std::vector<std::pair<double,int> > bounds;
+    level_bounds(cg, walk, wgh, lb);
+    for (i = 0; i < (int)R.size(); ++i) {
+        for (int z = 0; z < nz; ++z) {
+            w = lb[z] + initial_weight(R[i], NULL, 0, wgh, dom.lbound() + z);
+            bounds.push_back(std::make_pair(prune ? w * (1.0 - 1e-9) : 0.0, i * nz + z));
+        }
+    }
+    std::sort(bounds.begin(), bounds.end());
+    std::vector<const ChordGraph::GlueTable*> gt(nl + 1);
+    for (l = 1; l <= nl; ++l) {
+        gt[l] = &cg.glue_table(walk[l-1], walk[l]);
+    }
+    voicing_signatures vsig;
+    std::vector<ivector> first_id(nl + 1), second_id(nl + 1);
+    for (l = 1; l <= nl; ++l) {
+        for (j = 0; j < gt[l]->size(); ++j) {
+            first_id[l].push_back(vsig.set_id(gt[l]->transition(j).first()));
+            second_id[l].push_back(vsig.set_id(gt[l]->transition(j).second()));
+        }
+    }
+    /* compute the potentials and the optimal weight */
+    std::vector<near_optimal_candidate> cands;
+    for (std::vector<std::pair<double,int> >::const_iterator it = bounds.begin(); it != bounds.end(); ++it) {
+        if (it->first > thres) {
+            Profile::count(PROFILE_VOICING_CANDIDATES_PRUNED, bounds.end() - it);
+            break;
+        }
+        order = it->second;
+        cands.push_back(near_optimal_candidate());
+        near_optimal_candidate &c = cands.back();
+        c.r = R[order / nz];
+        c.z = dom.lbound() + order % nz;
+        c.root = vsig.extend(-1, -1, vsig.set_id(c.r));
+        c.h.resize(nl + 1);
+        if (nl == 0)
+            w = initial_weight(c.r, NULL, 0, wgh, c.z);
+        else {
+            n1 = gt[1]->size();
+            c.tcn0.resize(n1);
+            c.mc0.resize(n1);
+            int x0 = cg.predecessor_index(walk[0], c.r);
+            for (i = 0; i < n1; ++i) {
+                if (x0 >= 0) {
+                    c.tcn0[i] = gt[1]->row(x0)[i].tcn;
+                    c.mc0[i] = gt[1]->row(x0)[i].mc;
+                } else assert(gt[1]->transition(i).glue(c.r, c.mc0[i], c.tcn0[i], f0));
+            }
+            n2 = gt[nl]->size();
+            c.h[nl].assign(n2, 0);
+            if (nl == 1) {
+                for (j = 0; j < n2; ++j) {
+                    c.h[1][j] = initial_weight(c.r, &gt[1]->transition(j), c.tcn0[j], wgh, c.z);
+                }
+            }
+            for (l = nl - 1; l >= 1; --l) {
+                n1 = gt[l]->size();
+                n2 = gt[l+1]->size();
+                c.h[l].assign(n1, DBL_MAX);
+                for (i = 0; i < n1; ++i) {
+                    const Transition &t1 = gt[l]->transition(i);
+                    const ChordGraph::GlueTable::entry *row = gt[l+1]->row(gt[l]->target(i));
+                    for (j = 0; j < n2; ++j) {
+                        const Transition &t2 = gt[l+1]->transition(j);
+                        w = (l == 1 ? first_arc_weight(c.r, t1, c.tcn0[i], t2, row[j].tcn, wgh, c.z)
+                                    : arc_weight(t2, row[j].tcn, wgh, c.z)) + c.h[l+1][j];
+                        c.h[l][i] = std::min(c.h[l][i], w);
+                    }
+                }
+            }
+            w = *std::min_element(c.h[1].begin(), c.h[1].end());
+        }
+        if (w < theta) {
+            theta = w;
+            thres = relative ? theta + eps * fabs(theta) : theta + eps;
+            thres += 1e-9 * std::max(1.0, fabs(thres));
+        }
+    }
+    /* expand the partial paths in the order of the weights of their cheapest completions */
+    std::vector<near_optimal_node> nodes;
+    std::priority_queue<std::pair<double,int>,std::vector<std::pair<double,int> >,std::greater<std::pair<double,int> > > pq;
+    std::set<std::pair<ipair,ipair> > expanded;
+    std::set<int> found;
+    for (order = 0; order < (int)cands.size(); ++order) {
+        const near_optimal_candidate &c = cands[order];
+        if (nl == 0) {
+            w = initial_weight(c.r, NULL, 0, wgh, c.z);
+            if (w <= thres) {
+                near_optimal_node nd = { w, order, 0, 0, c.root, -1 };
+                pq.push(std::make_pair(w, nodes.size()));
+                nodes.push_back(nd);
+            }
+            continue;
+        }
+        for (i = 0; i < gt[1]->size(); ++i) {
+            if (c.h[1][i] <= thres) {
+                near_optimal_node nd = { 0, order, 1, i, vsig.extend(c.root, c.mc0[i] > 0 ? first_id[1][i] : -1, second_id[1][i]), -1 };
+                pq.push(std::make_pair(c.h[1][i], nodes.size()));
+                nodes.push_back(nd);
+            }
+        }
+    }
+    ivector path(nl + 1);
+    voicing v;
+    while (!pq.empty()) {
+        double key = pq.top().first;
+        int k = pq.top().second;
+        pq.pop();
+        near_optimal_node nd = nodes[k];
+        const near_optimal_candidate &c = cands[nd.cand];
+        if (!expanded.insert(std::make_pair(std::make_pair(nd.cand, nd.level), std::make_pair(nd.vertex, nd.sig))).second)
+            continue;
+        if (nd.level == nl) {
+            if (!found.insert(nd.sig).second)
+                continue;
+            ++count;
+            if (!f)
+                continue;
+            if (nl == 0) {
+                v.assign(1, std::make_pair(c.r, false));
+            } else {
+                for (int p = k; p >= 0; p = nodes[p].parent) {
+                    path[nodes[p].level] = nodes[p].vertex;
+                }
+                realize(cg, gt, c.r, path, v);
+            }
+            arrange_voices(v);
+            if (!f(key, v))
+                break;
+            continue;
+        }
+        l = nd.level;
+        const Transition &t1 = gt[l]->transition(nd.vertex);
+        const ChordGraph::GlueTable::entry *row = gt[l+1]->row(gt[l]->target(nd.vertex));
+        for (j = 0; j < gt[l+1]->size(); ++j) {
+            const Transition &t2 = gt[l+1]->transition(j);
+            w = nd.cost + (l == 1 ? first_arc_weight(c.r, t1, c.tcn0[nd.vertex], t2, row[j].tcn, wgh, c.z)
+                                  : arc_weight(t2, row[j].tcn, wgh, c.z));
+            if (w + c.h[l+1][j] > thres)
+                continue;
+            cue = row[j].mc > 0 ? first_id[l+1][j] : -1;
+            near_optimal_node next = { w, nd.cand, l + 1, j, vsig.extend(nd.sig, cue, second_id[l+1][j]), k };
+            pq.push(std::make_pair(w + c.h[l+1][j], nodes.size()));
+            nodes.push_back(next);
+        }
+    }
+    return count;
+}
+
 bool TransitionNetwork::are_voicings_equivalent(const voicing &v1, const voicing &v2) {
     assert(!v1.empty() && !v2.empty());
     if (v1.size() != v2.size())
@@ -238,7 +941,630 @@ bool TransitionNetwork::are_voicings_equivalent(const voicing &v1, const voicing
     return true;
 }
 
+/* A partial path in the beam search, given by its weight, the pair (X0,z), its last vertex (the index of X0
+ * in the first level) and the index of its prefix in the preceding level. */
+struct beam_node {
+    double cost;
+    int cand;
+    int vertex;
+    int parent;
+};
+
+static bool beam_node_order(const beam_node &a, const beam_node &b) {
+    if (a.cost != b.cost)
+        return a.cost < b.cost;
+    if (a.cand != b.cand)
+        return a.cand < b.cand;
+    return a.vertex < b.vertex;
+}
+
+static bool beam_node_key_order(const beam_node &a, const beam_node &b) {
+    if (a.cand != b.cand)
+        return a.cand < b.cand;
+    if (a.vertex != b.vertex)
+        return a.vertex < b.vertex;
+    if (a.cost != b.cost)
+        return a.cost < b.cost;
+    return a.parent < b.parent;
+}
+
+/* The partial paths of all pairs (X0,z) are extended level by level, where the paths with the same pair and
+ * the same last vertex are merged, and only the beam cheapest ones are kept in each level. If none of them was
+ * dropped, the search is exact. Otherwise it is repeated with twice the width until the deadline, and the
+ * cheapest voicing found is returned. The weights of the arcs are decomposed as in the forward pass in solve,
+ * with X0 accounted for in the first level. The lower bound is obtained from level_bounds. */
+int TransitionNetwork::find_voicing_beam(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh, int beam,
+                                         int deadline_ms, voicing &v, double &weight, double &bound) {
+    Profile::Timer timer("TransitionNetwork::find_voicing_beam");
+    assert(beam > 0);
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(deadline_ms, 0));
+    const Chord &c0 = cg.vertex2chord(walk.front());
+    Domain dom = cg.support();
+    int nz = dom.ubound() - dom.lbound() + 1, nl = walk.size() - 1, nc, l, i, j, n, c, width, best_c = -1;
+    bool pruned, expired = false, nonneg = wgh[0] >= 0 && wgh[1] >= 0 && wgh[2] >= 0;
+    std::vector<Realization> R = Realization::tonal_realizations(c0, dom, cg.allows_augmented_sixths());
+    nc = R.size() * nz;
+    std::vector<const ChordGraph::GlueTable*> gt(nl + 1, NULL);
+    for (l = 1; l <= nl; ++l) {
+        gt[l] = &cg.glue_table(walk[l-1], walk[l]);
+    }
+    /* the taxicab norms from each initial realization via the transitions in the first level */
+    std::vector<ivector> tcn0(R.size());
+    if (nl > 0) {
+        ivector f;
+        int x0, mc;
+        for (i = 0; i < int(R.size()); ++i) {
+            x0 = cg.predecessor_index(walk[0], R[i]);
+            tcn0[i].resize(gt[1]->size());
+            for (j = 0; j < gt[1]->size(); ++j) {
+                if (x0 >= 0)
+                    tcn0[i][j] = gt[1]->row(x0)[j].tcn;
+                else assert(gt[1]->transition(j).glue(R[i], mc, tcn0[i][j], f));
+            }
+        }
+    }
+    std::vector<double> lb;
+    if (nonneg)
+        level_bounds(cg, walk, wgh, lb);
+    bound = nonneg ? DBL_MAX : -DBL_MAX;
+    std::vector<std::vector<beam_node> > levels(nl + 1);
+    std::vector<beam_node> &roots = levels[0], next;
+    for (c = 0; c < nc; ++c) {
+        beam_node nd;
+        nd.cost = initial_weight(R[c / nz], NULL, 0, wgh, dom.lbound() + c % nz);
+        nd.cand = c;
+        nd.vertex = c / nz;
+        nd.parent = -1;
+        roots.push_back(nd);
+        if (nonneg)
+            bound = std::min(bound, nd.cost + lb[c % nz]);
+    }
+    std::sort(roots.begin(), roots.end(), beam_node_order);
+    ivector path(nl + 1);
+    weight = DBL_MAX;
+    for (width = beam; ; width *= 2) {
+        pruned = nl > 0 && int(roots.size()) > width;
+        for (l = 1; l <= nl; ++l) {
+            /* the first search is always completed */
+            if (width > beam && std::chrono::steady_clock::now() >= deadline) {
+                expired = true;
+                break;
+            }
+            const std::vector<beam_node> &prev = levels[l-1];
+            n = gt[l]->size();
+            next.clear();
+            for (i = 0; i < std::min(int(prev.size()), width); ++i) {
+                const beam_node &u = prev[i];
+                const ChordGraph::GlueTable::entry *row = l == 1 ? NULL : gt[l]->row(gt[l-1]->target(u.vertex));
+                for (j = 0; j < n; ++j) {
+                    beam_node nd;
+                    nd.cost = u.cost + arc_weight(gt[l]->transition(j), l == 1 ? tcn0[u.vertex][j] : row[j].tcn,
+                                                  wgh, dom.lbound() + u.cand % nz);
+                    nd.cand = u.cand;
+                    nd.vertex = j;
+                    nd.parent = i;
+                    next.push_back(nd);
+                }
+            }
+            /* merge the paths with the same pair and the same last vertex */
+            std::sort(next.begin(), next.end(), beam_node_key_order);
+            std::vector<beam_node> &cur = levels[l];
+            cur.clear();
+            for (std::vector<beam_node>::const_iterator it = next.begin(); it != next.end(); ++it) {
+                if (cur.empty() || cur.back().cand != it->cand || cur.back().vertex != it->vertex)
+                    cur.push_back(*it);
+            }
+            std::sort(cur.begin(), cur.end(), beam_node_order);
+            if (int(cur.size()) > width) {
+                cur.resize(width);
+                pruned = true;
+            }
+        }
+        if (expired)
+            break;
+        const beam_node &last = levels[nl].front();
+        if (last.cost < weight) {
+            weight = last.cost;
+            best_c = last.cand;
+            for (i = 0, l = nl; l >= 0; --l) {
+                const beam_node &nd = l == nl ? last : levels[l][i];
+                path[l] = nd.vertex;
+                i = nd.parent;
+            }
+            if (nl > 0)
+                realize(cg, gt, R[best_c / nz], path, v);
+            else {
+                v.clear();
+                v.push_back(std::make_pair(R[best_c / nz], false));
+            }
+        }
+        if (!pruned) {
+            bound = weight;
+            break;
+        }
+        if (std::chrono::steady_clock::now() >= deadline)
+            break;
+    }
+    bound = std::min(bound, weight);
+    arrange_voices(v);
+    return dom.lbound() + best_c % nz;
+}
+
+/* The number of levels in a segment of the walk in find_voicing_parallel. The segments do not depend on
+ * the number of threads, hence neither does the result. */
+static const int parallel_segment_length = 64;
+
+/* runs task(0), ..., task(n-1) in num_threads worker threads, which take the tasks from a shared counter */
+static void run_parallel(int n, int num_threads, const std::function<void(int)> &task) {
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < std::min(n, num_threads); ++t) {
+        workers.push_back(std::thread([&]() {
+            int i;
+            while ((i = next++) < n) {
+                task(i);
+            }
+        }));
+    }
+    for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); ++it) {
+        it->join();
+    }
+}
+
+/* The forward pass for the levels first+1, ..., last of a walk and a center of gravity. In the first segment
+ * (first = 0), it starts from the initial realizations and cost[j] is the weight of the cheapest path to the
+ * j-th vertex in the last level, which starts in the initial realization src[j]. Otherwise, cost[x*n+y] is the
+ * weight of the cheapest path from the x-th vertex in the first level to the y-th vertex in the last one,
+ * where n is the size of the last level. In both cases, parent[l-first-1] holds the predecessors of the
+ * vertices in the l-th level in the same layout (in the first level of the first segment, the initial
+ * realizations). */
+struct segment_pass {
+    int first, last;
+    std::vector<double> cost;
+    ivector src;
+    std::vector<ivector> parent;
+};
+
+/* The arc weights are computed once for each level and shared by all paths through the segment. */
+static void forward_segment(const std::vector<const ChordGraph::GlueTable*> &gt, const std::vector<Realization> &R,
+                            const std::vector<double> &wgh, int z, segment_pass &sp) {
+    int nx = sp.first == 0 ? 1 : gt[sp.first]->size(), n1, n2, x, i, j, l, p;
+    std::vector<double> cost, next_cost, w;
+    ivector src, next_src;
+    sp.parent.resize(sp.last - sp.first);
+    if (sp.first == 0) {
+        n1 = R.size();
+        cost.resize(n1);
+        src.resize(n1);
+        for (i = 0; i < n1; ++i) {
+            cost[i] = TransitionNetwork::initial_weight(R[i], NULL, 0, wgh, z);
+            src[i] = i;
+        }
+    } else {
+        n1 = nx;
+        cost.assign(nx * nx, DBL_MAX);
+        for (x = 0; x < nx; ++x) {
+            cost[x * nx + x] = 0;
+        }
+    }
+    for (l = sp.first + 1; l <= sp.last; ++l) {
+        n2 = gt[l]->size();
+        w.resize(n1 * n2);
+        for (i = 0; i < n1; ++i) {
+            /* the tonal realizations of the first chord come first among its predecessors */
+            const ChordGraph::GlueTable::entry *row = gt[l]->row(l == 1 ? i : gt[l-1]->target(i));
+            for (j = 0; j < n2; ++j) {
+                w[i * n2 + j] = TransitionNetwork::arc_weight(gt[l]->transition(j), row[j].tcn, wgh, z);
+            }
+        }
+        next_cost.assign(nx * n2, DBL_MAX);
+        ivector &parent = sp.parent[l - sp.first - 1];
+        parent.assign(nx * n2, -1);
+        if (sp.first == 0)
+            next_src.assign(n2, -1);
+        for (x = 0; x < nx; ++x) {
+            const double *c = &cost[x * n1];
+            double *nc = &next_cost[x * n2];
+            int *par = &parent[x * n2];
+            for (i = 0; i < n1; ++i) {
+                if (c[i] == DBL_MAX)
+                    continue;
+                for (j = 0; j < n2; ++j) {
+                    double d = c[i] + w[i * n2 + j];
+                    p = par[j];
+                    if (p < 0 || d < nc[j] || (sp.first == 0 && d == nc[j] && src[i] < next_src[j])) {
+                        nc[j] = d;
+                        par[j] = i;
+                        if (sp.first == 0)
+                            next_src[j] = src[i];
+                    }
+                }
+            }
+        }
+        cost.swap(next_cost);
+        src.swap(next_src);
+        n1 = n2;
+    }
+    sp.cost.swap(cost);
+    sp.src.swap(src);
+}
+
+/* The walk is split into segments of parallel_segment_length levels. For each center of gravity, the segments
+ * are processed in parallel (see forward_segment), after which the weights of the cheapest paths are passed
+ * from a segment to the next one by a min-plus product with its matrix, which is cheap since the levels are
+ * small. The centers of gravity are tried in the order of increasing lower bounds, as in find_voicing, where
+ * the paths for all initial realizations are found at once. Ties are resolved in favor of the path which
+ * starts in the earliest initial realization, but otherwise not necessarily as in find_voicing. */
+int TransitionNetwork::find_voicing_parallel(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh,
+                                             voicing &v, int num_threads) {
+    int nl = walk.size() - 1, ns = nl / parallel_segment_length, s, l, k, x, y, n, best_k = -1, best_src = 0;
+    if (ns < 2)
+        return find_voicing(cg, walk, wgh, v);
+    Profile::Timer timer("TransitionNetwork::find_voicing_parallel");
+    if (num_threads <= 0)
+        num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    const Domain &dom = cg.support();
+    int nz = dom.ubound() - dom.lbound() + 1;
+    std::vector<Realization> R = Realization::tonal_realizations(cg.vertex2chord(walk.front()), dom, cg.allows_augmented_sixths());
+    std::vector<const ChordGraph::GlueTable*> gt(nl + 1, NULL);
+    std::vector<segment_pass> sp(ns), best_sp;
+    std::vector<std::vector<double> > partial_lb(ns);
+    std::vector<double> lb(nz, 0), cost, next_cost;
+    ivector src, next_src, exits(ns);
+    std::vector<ivector> arg(ns);
+    for (s = 0; s < ns; ++s) {
+        sp[s].first = s * parallel_segment_length;
+        sp[s].last = s + 1 < ns ? sp[s].first + parallel_segment_length : nl;
+    }
+    run_parallel(ns, num_threads, [&](int s) {
+        for (int l = sp[s].first + 1; l <= sp[s].last; ++l) {
+            gt[l] = &cg.glue_table(walk[l-1], walk[l]);
+        }
+        level_bounds(cg, ivector(walk.begin() + sp[s].first, walk.begin() + sp[s].last + 1), wgh, partial_lb[s]);
+    });
+    bool prune = wgh[0] >= 0 && wgh[1] >= 0 && wgh[2] >= 0;
+    std::vector<std::pair<double,int> > cand;
+    for (k = 0; k < nz; ++k) {
+        double b = DBL_MAX;
+        for (s = 0; s < ns; ++s) {
+            lb[k] += partial_lb[s][k];
+        }
+        for (std::vector<Realization>::const_iterator it = R.begin(); it != R.end(); ++it) {
+            b = std::min(b, lb[k] + initial_weight(*it, NULL, 0, wgh, dom.lbound() + k));
+        }
+        cand.push_back(std::make_pair(prune ? b * (1.0 - 1e-9) : 0.0, k));
+    }
+    std::sort(cand.begin(), cand.end());
+    double min_w = 0;
+    for (std::vector<std::pair<double,int> >::const_iterator it = cand.begin(); it != cand.end(); ++it) {
+        if (prune && best_k >= 0 && it->first > min_w) {
+            Profile::count(PROFILE_VOICING_CANDIDATES_PRUNED, cand.end() - it);
+            break;
+        }
+        k = it->second;
+        run_parallel(ns, num_threads, [&](int s) {
+            forward_segment(gt, R, wgh, dom.lbound() + k, sp[s]);
+        });
+        cost = sp[0].cost;
+        src = sp[0].src;
+        for (s = 1; s < ns; ++s) {
+            n = gt[sp[s].last]->size();
+            next_cost.assign(n, DBL_MAX);
+            next_src.assign(n, -1);
+            arg[s].assign(n, -1);
+            for (x = 0; x < int(cost.size()); ++x) {
+                for (y = 0; y < n; ++y) {
+                    double c = cost[x] + sp[s].cost[x * n + y];
+                    if (arg[s][y] < 0 || c < next_cost[y] || (c == next_cost[y] && src[x] < next_src[y])) {
+                        next_cost[y] = c;
+                        next_src[y] = src[x];
+                        arg[s][y] = x;
+                    }
+                }
+            }
+            cost.swap(next_cost);
+            src.swap(next_src);
+        }
+        for (y = 0, x = 1; x < int(cost.size()); ++x) {
+            if (cost[x] < cost[y] || (cost[x] == cost[y] && src[x] < src[y]))
+                y = x;
+        }
+        /* ties are resolved as in find_voicing */
+        if (best_k < 0 || cost[y] < min_w || (cost[y] == min_w && src[y] * nz + k < best_src * nz + best_k)) {
+            min_w = cost[y];
+            best_k = k;
+            best_src = src[y];
+            best_sp = sp;
+            exits[ns-1] = y;
+            for (s = ns - 1; s > 0; --s) {
+                exits[s-1] = arg[s][exits[s]];
+            }
+        }
+    }
+    /* the path is traced back from the last vertex of each segment to the first one */
+    ivector path(nl + 1);
+    for (s = 0; s < ns; ++s) {
+        const segment_pass &p = best_sp[s];
+        x = s > 0 ? exits[s-1] : 0;
+        y = exits[s];
+        for (l = p.last; l > p.first; --l) {
+            path[l] = y;
+            y = p.parent[l - p.first - 1][x * gt[l]->size() + y];
+        }
+        assert(s == 0 ? y == best_src : y == x);
+    }
+    realize(cg, gt, R[best_src], path, v);
+    arrange_voices(v);
+    return dom.lbound() + best_k;
+}
+
+/* The forward pass is that of VoicingEditor, where the initial realizations form level 0 and the source of
+ * a path is the pair (initial realization, first transition), encoded as a single integer. The components
+ * of the arc weights are computed once, namely the distances of the realizations from each center of gravity,
+ * the augmented-sixth indicators and the voice-leading terms, and the weights for each weight vector are
+ * combined from them in the same way as in arc_weight. The weights, sources and parents in a level are stored
+ * with the weight vectors as the innermost index, so that all weight vectors are processed in a single loop. */
+void TransitionNetwork::sweep_weights(const ChordGraph &cg, const ivector &walk, const std::vector<std::vector<double> > &wgh,
+                                      std::vector<voicing> &v, std::vector<double> &weight, ivector &z0, ivector &same) {
+    Profile::Timer timer("TransitionNetwork::sweep_weights");
+    const Domain &dom = cg.support();
+    int nw = wgh.size(), nz = dom.ubound() - dom.lbound() + 1, nl = walk.size() - 1, l, i, j, k, t, n1, n2, p, s, b;
+    std::vector<Realization> R = Realization::tonal_realizations(cg.vertex2chord(walk.front()), dom, cg.allows_augmented_sixths());
+    std::vector<const ChordGraph::GlueTable*> gt(nl + 1, NULL);
+    std::vector<std::vector<double> > dist(nl + 1), vl(nl + 1);
+    std::vector<std::vector<bool> > aug(nl + 1);
+    /* the components in level 0 belong to the initial realizations */
+    dist[0].resize(R.size() * nz);
+    for (i = 0; i < int(R.size()); ++i) {
+        for (k = 0; k < nz; ++k) {
+            dist[0][i * nz + k] = R[i].lof_point_distance(dom.lbound() + k);
+        }
+        aug[0].push_back(R[i].is_augmented_sixth());
+    }
+    for (n1 = R.size(), l = 1; l <= nl; ++l, n1 = n2) {
+        gt[l] = &cg.glue_table(walk[l-1], walk[l]);
+        n2 = gt[l]->size();
+        dist[l].resize(n2 * nz);
+        vl[l].resize(n1 * n2);
+        for (j = 0; j < n2; ++j) {
+            const Realization &r = gt[l]->transition(j).second();
+            for (k = 0; k < nz; ++k) {
+                dist[l][j * nz + k] = r.lof_point_distance(dom.lbound() + k);
+            }
+            aug[l].push_back(r.is_augmented_sixth());
+        }
+        for (i = 0; i < n1; ++i) {
+            /* the tonal realizations of the first chord come first among its predecessors */
+            const ChordGraph::GlueTable::entry *row = gt[l]->row(l == 1 ? i : gt[l-1]->target(i));
+            for (j = 0; j < n2; ++j) {
+                vl[l][i * n2 + j] = sqrt(row[j].tcn / 4);
+            }
+        }
+    }
+    int ns = nl > 0 ? gt[1]->size() : 1;
+    std::vector<double> cost, next_cost, w(nw);
+    ivector src, next_src;
+    std::vector<ivector> parent(nl + 1), path(nw, ivector(nl + 1));
+    weight.assign(nw, 0);
+    z0.assign(nw, 0);
+    ivector best_src(nw, -1), best_k(nw, -1);
+    for (k = 0; k < nz; ++k) {
+        n1 = R.size();
+        cost.resize(n1 * nw);
+        src.resize(n1 * nw);
+        for (i = 0; i < n1; ++i) {
+            for (t = 0; t < nw; ++t) {
+                double c = wgh[t][0] * dist[0][i * nz + k];
+                if (aug[0][i])
+                    c += wgh[t][2];
+                cost[i * nw + t] = c;
+                src[i * nw + t] = i * ns;
+            }
+        }
+        for (l = 1; l <= nl; ++l, n1 = n2) {
+            n2 = gt[l]->size();
+            next_cost.assign(n2 * nw, DBL_MAX);
+            next_src.assign(n2 * nw, -1);
+            parent[l].assign(n2 * nw, -1);
+            for (i = 0; i < n1; ++i) {
+                for (j = 0; j < n2; ++j) {
+                    double d = dist[l][j * nz + k], e = vl[l][i * n2 + j];
+                    bool a = aug[l][j];
+                    const double *c = &cost[i * nw];
+                    const int *sc = &src[i * nw];
+                    double *nc = &next_cost[j * nw];
+                    int *nsc = &next_src[j * nw], *par = &parent[l][j * nw];
+                    for (t = 0; t < nw; ++t) {
+                        w[t] = wgh[t][0] * d + e * wgh[t][1];
+                        if (a)
+                            w[t] += wgh[t][2];
+                    }
+                    for (t = 0; t < nw; ++t) {
+                        double x = c[t] + w[t];
+                        s = l == 1 ? i * ns + j : sc[t];
+                        p = par[t];
+                        if (p < 0 || x < nc[t] ||
+                                (x == nc[t] && (s < nsc[t] || (s == nsc[t] && c[t] < cost[p * nw + t])))) {
+                            nc[t] = x;
+                            nsc[t] = s;
+                            par[t] = i;
+                        }
+                    }
+                }
+            }
+            cost.swap(next_cost);
+            src.swap(next_src);
+        }
+        /* the sink is chosen as in VoicingEditor::find_voicing, and so is the center of gravity */
+        for (t = 0; t < nw; ++t) {
+            for (b = 0, j = 1; j < n1; ++j) {
+                if (cost[j * nw + t] < cost[b * nw + t] || (cost[j * nw + t] == cost[b * nw + t] && src[j * nw + t] < src[b * nw + t]))
+                    b = j;
+            }
+            double c = cost[b * nw + t];
+            s = src[b * nw + t];
+            if (best_k[t] >= 0 && (c > weight[t] || (c == weight[t] && s / ns >= best_src[t] / ns)))
+                continue;
+            weight[t] = c;
+            best_k[t] = k;
+            best_src[t] = s;
+            for (j = b, l = nl; l > 0; --l) {
+                path[t][l] = j;
+                j = parent[l][j * nw + t];
+            }
+        }
+    }
+    v.resize(nw);
+    same.resize(nw);
+    std::map<voicing,int> first;
+    for (t = 0; t < nw; ++t) {
+        const Realization &r = R[best_src[t] / ns];
+        if (nl > 0)
+            realize(cg, gt, r, path[t], v[t]);
+        else {
+            v[t].clear();
+            v[t].push_back(std::make_pair(r, false));
+        }
+        arrange_voices(v[t]);
+        z0[t] = dom.lbound() + best_k[t];
+        same[t] = first.insert(std::make_pair(v[t], t)).first->second;
+    }
+}
+
+/* A partial path in the Pareto search, given by its components (see find_pareto_voicings), its last vertex
+ * (in level 0, the initial realization) and the index of its prefix among the labels of the preceding level. */
+struct pareto_label {
+    double spread;
+    double vl;
+    int aug;
+    int vertex;
+    int parent;
+    bool operator <(const pareto_label &other) const {
+        if (spread != other.spread)
+            return spread < other.spread;
+        if (vl != other.vl)
+            return vl < other.vl;
+        return aug < other.aug;
+    }
+};
+
+/* removes from labels, which must be sorted, those dominated by (or equal to) a preceding one, which is the case
+ * iff a preceding label with at most as many augmented sixths has at most the same voice-leading term */
+static void pareto_filter(std::vector<pareto_label> &labels) {
+    std::vector<pareto_label> kept;
+    std::vector<double> min_vl;
+    for (std::vector<pareto_label>::const_iterator it = labels.begin(); it != labels.end(); ++it) {
+        /* min_vl[a] is the least voice-leading term among the kept labels with at most a augmented sixths */
+        int a = std::min(it->aug, int(min_vl.size()) - 1);
+        if (a >= 0 && min_vl[a] <= it->vl)
+            continue;
+        kept.push_back(*it);
+        if (int(min_vl.size()) <= it->aug)
+            min_vl.resize(it->aug + 1, min_vl.empty() ? DBL_MAX : min_vl.back());
+        for (a = it->aug; a < int(min_vl.size()); ++a) {
+            min_vl[a] = std::min(min_vl[a], it->vl);
+        }
+    }
+    labels.swap(kept);
+}
+
+/* For each center of gravity, the non-dominated partial paths to each vertex are found level by level, since
+ * a path is dominated if its prefix to some vertex is. A voicing may be found for several centers of gravity,
+ * but only the copy with the least spread survives the final filter. */
+std::vector<std::pair<std::vector<double>,voicing> > TransitionNetwork::find_pareto_voicings(const ChordGraph &cg, const ivector &walk,
+                                                                                            ivector &z0) {
+    Profile::Timer timer("TransitionNetwork::find_pareto_voicings");
+    const Domain &dom = cg.support();
+    int nz = dom.ubound() - dom.lbound() + 1, nl = walk.size() - 1, l, i, j, k, n;
+    std::vector<Realization> R = Realization::tonal_realizations(cg.vertex2chord(walk.front()), dom, cg.allows_augmented_sixths());
+    std::vector<const ChordGraph::GlueTable*> gt(nl + 1, NULL);
+    for (l = 1; l <= nl; ++l) {
+        gt[l] = &cg.glue_table(walk[l-1], walk[l]);
+    }
+    std::vector<std::vector<pareto_label> > labels(nl + 1);
+    std::vector<std::vector<pareto_label> > cand;
+    /* the non-dominated labels in the last level for all centers of gravity, with the center in vertex and
+     * the initial realization and the path in found[parent] */
+    std::vector<pareto_label> front;
+    std::vector<std::pair<int,ivector> > found;
+    for (k = 0; k < nz; ++k) {
+        int z = dom.lbound() + k;
+        labels[0].clear();
+        for (i = 0; i < int(R.size()); ++i) {
+            pareto_label lab;
+            lab.spread = R[i].lof_point_distance(z);
+            lab.vl = 0;
+            lab.aug = R[i].is_augmented_sixth() ? 1 : 0;
+            lab.vertex = i;
+            lab.parent = -1;
+            labels[0].push_back(lab);
+        }
+        for (l = 1; l <= nl; ++l) {
+            n = gt[l]->size();
+            cand.assign(n, std::vector<pareto_label>());
+            const std::vector<pareto_label> &prev = labels[l-1];
+            for (i = 0; i < int(prev.size()); ++i) {
+                /* the tonal realizations of the first chord come first among its predecessors */
+                const ChordGraph::GlueTable::entry *row = gt[l]->row(l == 1 ? prev[i].vertex : gt[l-1]->target(prev[i].vertex));
+                for (j = 0; j < n; ++j) {
+                    const Realization &r = gt[l]->transition(j).second();
+                    pareto_label lab;
+                    lab.spread = prev[i].spread + r.lof_point_distance(z);
+                    lab.vl = prev[i].vl + sqrt(row[j].tcn / 4);
+                    lab.aug = prev[i].aug + (r.is_augmented_sixth() ? 1 : 0);
+                    lab.vertex = j;
+                    lab.parent = i;
+                    cand[j].push_back(lab);
+                }
+            }
+            labels[l].clear();
+            for (j = 0; j < n; ++j) {
+                std::stable_sort(cand[j].begin(), cand[j].end());
+                pareto_filter(cand[j]);
+                labels[l].insert(labels[l].end(), cand[j].begin(), cand[j].end());
+            }
+        }
+        std::vector<pareto_label> last(labels[nl]);
+        std::stable_sort(last.begin(), last.end());
+        pareto_filter(last);
+        for (std::vector<pareto_label>::const_iterator it = last.begin(); it != last.end(); ++it) {
+            ivector path(nl + 1);
+            const pareto_label *lab = &*it;
+            for (l = nl; l > 0; --l) {
+                path[l] = lab->vertex;
+                lab = &labels[l-1][lab->parent];
+            }
+            pareto_label f = *it;
+            f.vertex = z;
+            f.parent = found.size();
+            front.push_back(f);
+            found.push_back(std::make_pair(lab->vertex, path));
+        }
+    }
+    std::stable_sort(front.begin(), front.end());
+    pareto_filter(front);
+    std::vector<std::pair<std::vector<double>,voicing> > ret;
+    z0.clear();
+    for (std::vector<pareto_label>::const_iterator it = front.begin(); it != front.end(); ++it) {
+        std::vector<double> c;
+        c.push_back(it->spread);
+        c.push_back(it->vl);
+        c.push_back(it->aug);
+        voicing v;
+        const Realization &r = R[found[it->parent].first];
+        if (nl > 0)
+            realize(cg, gt, r, found[it->parent].second, v);
+        else v.push_back(std::make_pair(r, false));
+        arrange_voices(v);
+        ret.push_back(std::make_pair(c, v));
+        z0.push_back(it->vertex);
+    }
+    return ret;
+}
+
 std::set<voicing> TransitionNetwork::find_all_optimal_voicings(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh) {
+    Profile::Timer timer("TransitionNetwork::find_all_optimal_voicings");
     const Chord &c0 = cg.vertex2chord(walk.front());
     Domain dom = cg.support();
     double theta;
@@ -23,18 +23,27 @@
 
 #include "digraph.h"
 #include "chordgraph.h"
+#include <functional>
+#include <memory>
 
 class TransitionNetwork : public Digraph {
 
     Realization X0;
     int nl;
     int M;
-    int _num_paths;
+    unsigned long long _num_paths;
+    double _log_num_paths;
     ivector _sources;
     ivector _sinks;
-    std::map<int,const Transition*> transition_map;
-    std::map<glp_arc*,bool> cues_map;
-    std::map<glp_arc*,ivector> phi_map;
+    ivector _level_start;                   // the first vertex in each level, levels are numbered from 1
+    ivector _vertex_level;                  // the level of each vertex
+    std::vector<const Transition*> _trans;  // the transition corresponding to each vertex
+    ivector _arc_offset;                    // the index of the first arc leaving each level
+    std::vector<unsigned char> _phi;        // voice mapping for each arc, given as an index in Transition::sym4
+    std::vector<bool> _cues;                // for each arc, true iff a cue is required
+
+    int level_size(int l) const;
+    int arc_index(int i, int j) const;
 
 public:
     TransitionNetwork(const ChordGraph &cg, const ivector &walk, const Realization &r, const std::vector<double> &wgh, int z);
@@ -49,8 +58,11 @@ public:
     int num_levels() const;
     /* returns the number of levels in this network */
 
-    int num_paths() const;
-    /* returns the total number of paths from a source to a sink in this network */
+    unsigned long long num_paths() const;
+    /* returns the total number of paths from a source to a sink in this network (saturated at ULLONG_MAX) */
+
+    double log_num_paths() const;
+    /* returns the natural logarithm of the total number of paths from a source to a sink */
 
     ivector best_path(bool use_dijkstra = true);
     /* return a cheapest path from source to sink */
@@ -64,12 +76,139 @@ public:
     voicing realize_path(const ivector &path);
     /* returns the pitch spelling corresponding to path */
 
+    static double arc_weight(const Transition &t, int tcn, const std::vector<double> &wgh, int z);
+    /* returns the weight of an arc entering the vertex of t in a network with center of gravity z and weights wgh
+     *  - tcn is the taxicab norm of voice leading from the preceding realization to the second realization in t
+     */
+
+    static double first_arc_weight(const Realization &X0, const Transition &t1, int tcn1,
+                                   const Transition &t2, int tcn2, const std::vector<double> &wgh, int z);
+    /* returns the weight of an arc from the first to the second level, which also accounts for
+     * the initial realization X0 and the first transition t1 (tcn1 is the taxicab norm from X0 via t1) */
+
+    static double initial_weight(const Realization &X0, const Transition *t1, int tcn1, const std::vector<double> &wgh, int z);
+    /* returns the weight of a path consisting only of the initial realization X0 and the first transition t1
+     * (if t1 = NULL, only X0 is taken into account) */
+
+    struct Frontier {
+        int level;                              // levels are numbered from 1
+        const ChordGraph::GlueTable *glue;      // the glue table of the arc entering the level
+        std::vector<double> cost;               // the weight of the cheapest path to each vertex in the level
+        ivector src;                            // the source in which that path starts
+        ivector parent;                         // its vertex in the preceding level (empty in the first level)
+        ivector tcn0;                           // the taxicab norms from the initial realization (only in the first level)
+        std::shared_ptr<const Frontier> prev;   // the frontier of the preceding level
+    };
+    /* the state of the forward pass in solve after a level, which depends only on the walk up to that level,
+     * the initial realization, the center of gravity and the weights */
+
+    static std::shared_ptr<const Frontier> first_frontier(const ChordGraph &cg, const ivector &walk, const Realization &r);
+    /* returns the frontier of the first level for walk in cg with initial realization r (walk must have at least two vertices) */
+
+    static std::shared_ptr<const Frontier> next_frontier(const ChordGraph &cg, const ivector &walk, const Realization &r,
+                                                         const std::vector<double> &wgh, int z,
+                                                         const std::shared_ptr<const Frontier> &prev);
+    /* returns the frontier of the level following prev for walk in cg with initial realization r, center of gravity z
+     * and weights wgh */
+
+    static void realize(const ChordGraph &cg, const std::vector<const ChordGraph::GlueTable*> &gt,
+                        const Realization &r, const ivector &path, voicing &v);
+    /* stores into v the voicing with initial realization r which passes through the path[l]-th transition in
+     * the glue table gt[l] for each level l = 1, ..., n, where n + 1 is the size of path (path[0] and gt[0] are unused) */
+
+    static double finish(const ChordGraph &cg, const ivector &walk, const Realization &r,
+                         const std::vector<double> &wgh, int z, const Frontier &last, voicing &v);
+    /* chooses a cheapest path from the frontier of the last level for walk, stores the corresponding voicing in v
+     * and returns the weight of the path */
+
+    static double solve(const ChordGraph &cg, const ivector &walk, const Realization &r,
+                        const std::vector<double> &wgh, int z, voicing &v);
+    /* finds a cheapest path in the network for walk in cg with initial realization r, center of gravity z and weights wgh
+     * without constructing the network, stores the corresponding voicing in v and returns the weight of the path
+     *  - the network is processed level by level (see first_frontier, next_frontier and finish)
+     *  - the result is the same as with best_path and realize_path
+     */
+
+    static void solve(const ChordGraph &cg, const ivector &walk, const Realization &r,
+                      const std::vector<double> &wgh, int z, int k, std::vector<std::pair<double,voicing> > &vs);
+    /* finds the k cheapest paths with distinct voicings in the network for walk in cg with initial realization r,
+     * center of gravity z and weights wgh, and stores their weights and voicings in vs in increasing order of weight
+     *  - the first path is the one found by the other overload
+     *  - the voices are not arranged (see arrange_voices)
+     */
+
+    static void level_bounds(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh, std::vector<double> &lb);
+    /* stores into lb[z-m], for each z in the support of cg with lower bound m, a lower bound on the weight of a path
+     * for walk with center of gravity z and weights wgh, excluding the initial realization (see initial_weight)
+     *  - the weights must be nonnegative
+     */
+
     static ivector compose(const ivector &f1, const ivector &f2);
     /* returns the composition of two permutations f1 and f2 */
 
     static int find_voicing(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh, voicing &v, bool best = true);
     /* finds an optimal voicing v for walk in cg and returns its gravity center on the line of fifths */
 
+    static int find_voicing(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh, voicing &v,
+                            const std::function<double(const Realization&,int,voicing&)> &solver);
+    /* finds an optimal voicing v for walk in cg as above, where the cheapest path for the initial realization X0
+     * and the center of gravity z is found by solver(X0, z, v), which must return its weight (see solve) */
+
+    static std::vector<std::pair<double,voicing> > find_best_voicings(const ChordGraph &cg, const ivector &walk,
+                                                                      const std::vector<double> &wgh, int k);
+    /* returns the k best distinct voicings for walk in cg (or all of them, if there are fewer) with their weights,
+     * ranked in increasing order of weight
+     *  - the first voicing is the one found by find_voicing
+     */
+
+    static unsigned long long find_near_optimal_voicings(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh,
+                                                         double eps, bool relative,
+                                                         const std::function<bool(double,const voicing&)> &f);
+    /* enumerates the distinct voicings for walk in cg whose weight exceeds the optimal weight theta by at most eps
+     * (if relative = true, by at most eps*|theta|) in increasing order of weight, calling f with the weight and
+     * the voicing for each of them, and returns the number of voicings enumerated
+     *  - the enumeration stops when f returns false
+     *  - if f is empty, the voicings are only counted and not constructed
+     */
+
+    static int find_voicing_beam(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh, int beam,
+                                 int deadline_ms, voicing &v, double &weight, double &bound);
+    /* finds a voicing v for walk in cg by beam search with initial width beam, which is doubled while the deadline
+     * (in milliseconds from now) has not expired, and returns its gravity center on the line of fifths
+     *  - the weight of v is stored in weight and a lower bound on the optimal weight in bound
+     *    (-DBL_MAX if some weights are negative, unless v is known to be optimal, in which case bound = weight)
+     *  - the first search is always completed, hence the deadline may be exceeded by its duration
+     */
+
+    static int find_voicing_parallel(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh,
+                                     voicing &v, int num_threads = 0);
+    /* finds an optimal voicing v for walk in cg and returns its gravity center on the line of fifths, splitting
+     * walk into segments which are processed in num_threads worker threads (if 0, use all hardware threads)
+     *  - the weight of v is the same as with find_voicing, up to rounding errors, but ties may be resolved differently
+     *  - the result does not depend on num_threads
+     *  - walks with fewer than two segments are passed to find_voicing
+     */
+
+    static void sweep_weights(const ChordGraph &cg, const ivector &walk, const std::vector<std::vector<double> > &wgh,
+                              std::vector<voicing> &v, std::vector<double> &weight, ivector &z0, ivector &same);
+    /* finds an optimal voicing for walk in cg for each weight vector wgh[t], storing it in v[t], its weight in weight[t]
+     * and its gravity center on the line of fifths in z0[t]
+     *  - same[t] is the least index s such that v[s] = v[t]
+     *  - the network is built only once for all weight vectors
+     *  - the results are the same as with find_voicing, up to rounding errors
+     */
+
+    static std::vector<std::pair<std::vector<double>,voicing> > find_pareto_voicings(const ChordGraph &cg, const ivector &walk,
+                                                                                     ivector &z0);
+    /* returns the Pareto-optimal voicings for walk in cg with their components, which are the sum of the distances
+     * of the realizations from the center of gravity (the least one among the centers in the support), the sum of
+     * the voice-leading terms and the number of augmented sixths, in lexicographic order of the components
+     *  - the gravity center of the k-th voicing is stored in z0[k]
+     *  - the weight of a voicing is the dot product of its components with the weight vector, hence for any
+     *    nonnegative weights, an optimal voicing is among these (up to voicings with the same components,
+     *    of which only one is kept)
+     */
+
     static std::set<voicing> find_all_optimal_voicings(const ChordGraph &cg, const ivector &walk, const std::vector<double> &wgh);
     /* returns all optimal voicings for walk in cg */
 
@@ -0,0 +1,251 @@
+/* transitionstatistics.cpp
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "transitionstatistics.h"
+#include "profile.h"
+#include <unordered_set>
+#include <thread>
+#include <atomic>
+
+TransitionStatistics::TransitionStatistics() {
+    _total = _efficient = _vl_shift_sum = _fixed_common_tones = _contrary = _duplicates = 0;
+}
+
+void TransitionStatistics::add(const Transition &t) {
+    int D = t.first().chord().vl_efficiency_metric(t.second().chord());
+    int vls = t.vl_shift();
+    ++_total;
+    ++_vl_shift_dist[vls];
+    ++_mn_type_dist[t.mn_type()];
+    _vl_shift_sum += vls;
+    if (vls <= D)
+        ++_efficient;
+    else _excess[D] += vls - D;
+    if (t.acts_identically_on_pc_intersection())
+        ++_fixed_common_tones;
+    if (t.directional_vl_shift() < vls)
+        ++_contrary;
+}
+
+void TransitionStatistics::merge(const TransitionStatistics &other) {
+    _total += other._total;
+    _efficient += other._efficient;
+    _vl_shift_sum += other._vl_shift_sum;
+    _fixed_common_tones += other._fixed_common_tones;
+    _contrary += other._contrary;
+    _duplicates += other._duplicates;
+    for (std::map<int,int>::const_iterator it = other._vl_shift_dist.begin(); it != other._vl_shift_dist.end(); ++it) {
+        _vl_shift_dist[it->first] += it->second;
+    }
+    for (std::map<ipair,int>::const_iterator it = other._mn_type_dist.begin(); it != other._mn_type_dist.end(); ++it) {
+        _mn_type_dist[it->first] += it->second;
+    }
+    for (std::map<int,int>::const_iterator it = other._excess.begin(); it != other._excess.end(); ++it) {
+        _excess[it->first] += it->second;
+    }
+}
+
+int TransitionStatistics::total() const {
+    return _total;
+}
+
+int TransitionStatistics::efficient() const {
+    return _efficient;
+}
+
+double TransitionStatistics::efficient_percentage() const {
+    return _total == 0 ? 0 : (_efficient * 100.0) / (double)_total;
+}
+
+double TransitionStatistics::average_vl_shift() const {
+    return _total == 0 ? 0 : _vl_shift_sum / (double)_total;
+}
+
+double TransitionStatistics::average_relative_excess() const {
+    if (_total == 0)
+        return 0;
+    double pde = 0.0;
+    for (std::map<int,int>::const_iterator it = _excess.begin(); it != _excess.end(); ++it) {
+        pde += it->second / (double)it->first;
+    }
+    return pde / (double)_total;
+}
+
+int TransitionStatistics::fixed_common_tones() const {
+    return _fixed_common_tones;
+}
+
+int TransitionStatistics::contrary_motion() const {
+    return _contrary;
+}
+
+int TransitionStatistics::duplicates() const {
+    return _duplicates;
+}
+
+const std::map<int,int> &TransitionStatistics::vl_shift_distribution() const {
+    return _vl_shift_dist;
+}
+
+const std::map<ipair,int> &TransitionStatistics::mn_type_distribution() const {
+    return _mn_type_dist;
+}
+
+/* Histograms are written as arrays of [key..., count] entries in increasing key order. */
+void TransitionStatistics::write_json(std::ostream &os) const {
+    os << "{\"type\":\"transition-statistics\",\"version\":1"
+       << ",\"total\":" << _total << ",\"efficient\":" << _efficient << ",\"vl_shift_sum\":" << _vl_shift_sum
+       << ",\"fixed_common_tones\":" << _fixed_common_tones << ",\"contrary\":" << _contrary
+       << ",\"duplicates\":" << _duplicates << ",\"vl_shift\":[";
+    for (std::map<int,int>::const_iterator it = _vl_shift_dist.begin(); it != _vl_shift_dist.end(); ++it) {
+        os << (it == _vl_shift_dist.begin() ? "" : ",") << "[" << it->first << "," << it->second << "]";
+    }
+    os << "],\"mn_type\":[";
+    for (std::map<ipair,int>::const_iterator it = _mn_type_dist.begin(); it != _mn_type_dist.end(); ++it) {
+        os << (it == _mn_type_dist.begin() ? "" : ",")
+           << "[" << it->first.first << "," << it->first.second << "," << it->second << "]";
+    }
+    os << "],\"excess\":[";
+    for (std::map<int,int>::const_iterator it = _excess.begin(); it != _excess.end(); ++it) {
+        os << (it == _excess.begin() ? "" : ",") << "[" << it->first << "," << it->second << "]";
+    }
+    os << "]}";
+}
+
+bool TransitionStatistics::read_json(const JsonValue &v) {
+    *this = TransitionStatistics();
+    if (!v.has("type") || v["type"].kind() != JsonValue::JSON_STRING || v["type"].string() != "transition-statistics")
+        return false;
+    int version;
+    if (!v.get("version", version) || version != 1 || !v.get("total", _total) || !v.get("efficient", _efficient) ||
+            !v.get("vl_shift_sum", _vl_shift_sum) || !v.get("fixed_common_tones", _fixed_common_tones) ||
+            !v.get("contrary", _contrary) || !v.get("duplicates", _duplicates))
+        return false;
+    const char *hist[] = { "vl_shift", "mn_type", "excess" };
+    for (int k = 0; k < 3; ++k) {
+        if (!v.has(hist[k]) || v[hist[k]].kind() != JsonValue::JSON_ARRAY)
+            return false;
+        const JsonValue &h = v[hist[k]];
+        for (int i = 0; i < h.size(); ++i) {
+            if (!h[i].is_integer_array(k == 1 ? 3 : 2))
+                return false;
+            if (k == 0)
+                _vl_shift_dist[h[i][0].integer()] += h[i][1].integer();
+            else if (k == 1)
+                _mn_type_dist[std::make_pair(h[i][0].integer(), h[i][1].integer())] += h[i][2].integer();
+            else _excess[h[i][0].integer()] += h[i][1].integer();
+        }
+    }
+    return true;
+}
+
+/* The key consists of the position of the lowest tone on the line of fifths modulo 12, followed by
+ * the sorted voice-leading pairs taken relative to that tone (see Transition::is_structurally_equal). */
+ivector TransitionStatistics::canonical_key(const Transition &t, bool retrograde) {
+    int m = t.tone_set().begin()->lof_position();
+    std::vector<ipair> vl(4);
+    for (int i = 0; i < 4; ++i) {
+        vl[i] = std::make_pair(t.first().tone(i).lof_position() - m, t.second().tone(i).lof_position() - m);
+    }
+    std::sort(vl.begin(), vl.end());
+    ivector key(9);
+    key[0] = Tone::modb(m, 12);
+    for (int i = 0; i < 4; ++i) {
+        key[2*i+1] = vl[i].first;
+        key[2*i+2] = vl[i].second;
+    }
+    if (retrograde) {
+        ivector rkey = canonical_key(t.retrograde());
+        if (rkey < key)
+            return rkey;
+    }
+    return key;
+}
+
+int TransitionStatistics::remove_duplicates(std::vector<Transition> &trans, bool retrograde) {
+    std::unordered_set<ivector,key_hash> keys;
+    keys.reserve(trans.size());
+    std::vector<Transition>::iterator dest = trans.begin();
+    for (std::vector<Transition>::const_iterator it = trans.begin(); it != trans.end(); ++it) {
+        if (keys.insert(canonical_key(*it, retrograde)).second)
+            *(dest++) = *it;
+    }
+    int removed = trans.end() - dest;
+    trans.erase(dest, trans.end());
+    Profile::count(PROFILE_TRANSITIONS_DEDUPLICATED, removed);
+    return removed;
+}
+
+TransitionStatistics TransitionStatistics::compute(const std::vector<Chord> &chords, int k, PreparationScheme p, int z,
+                                                   bool aug, bool respell_aug, bool favor_diatonic, int num_threads) {
+    Profile::Timer timer("TransitionStatistics::compute");
+    if (num_threads <= 0)
+        num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<ipair> pairs;
+    int n = chords.size();
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            if (i != j)
+                pairs.push_back(std::make_pair(i, j));
+        }
+    }
+    /* generate the transitions for each pair of chords, results are stored in the order of pairs */
+    std::vector<std::vector<Transition> > lists(pairs.size());
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; ++t) {
+        workers.push_back(std::thread([&]() {
+            int i;
+            while ((i = next++) < (int)pairs.size()) {
+                std::vector<Transition> &lst = lists[i];
+                lst = Transition::elementary_classes(chords[pairs[i].first], chords[pairs[i].second], k, p, z, aug);
+                Transition::simplify_enharmonic_classes(lst, respell_aug, favor_diatonic);
+            }
+        }));
+    }
+    for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); ++it) {
+        it->join();
+    }
+    workers.clear();
+    std::vector<Transition> trans;
+    for (std::vector<std::vector<Transition> >::const_iterator it = lists.begin(); it != lists.end(); ++it) {
+        trans.insert(trans.end(), it->begin(), it->end());
+    }
+    lists.clear();
+    int dup = remove_duplicates(trans, p == NO_PREPARATION);
+    /* accumulate in per-thread partial aggregates, all counters are integers so the merge is exact */
+    std::vector<TransitionStatistics> partial(num_threads);
+    int chunk = (trans.size() + num_threads - 1) / num_threads;
+    for (int t = 0; t < num_threads; ++t) {
+        workers.push_back(std::thread([&,t]() {
+            int lb = t * chunk, ub = std::min((int)trans.size(), lb + chunk);
+            for (int i = lb; i < ub; ++i) {
+                partial[t].add(trans[i]);
+            }
+        }));
+    }
+    TransitionStatistics ret;
+    for (int t = 0; t < num_threads; ++t) {
+        workers[t].join();
+        ret.merge(partial[t]);
+    }
+    ret._duplicates = dup;
+    return ret;
+}
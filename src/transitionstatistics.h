@@ -0,0 +1,116 @@
+/* transitionstatistics.h
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRANSITIONSTATISTICS_H
+#define TRANSITIONSTATISTICS_H
+
+#include "transition.h"
+#include "json.h"
+#include <map>
+
+class TransitionStatistics {
+
+    int _total;
+    int _efficient;
+    int _vl_shift_sum;
+    int _fixed_common_tones;
+    int _contrary;
+    int _duplicates;
+    std::map<int,int> _vl_shift_dist;
+    std::map<ipair,int> _mn_type_dist;
+    std::map<int,int> _excess; // total voice-leading excess, keyed by the efficient shift
+
+    struct key_hash {
+        size_t operator ()(const ivector &key) const {
+            size_t h = 14695981039346656037ULL;
+            for (ivector::const_iterator it = key.begin(); it != key.end(); ++it) {
+                h = (h ^ (size_t)(*it + 64)) * 1099511628211ULL;
+            }
+            return h;
+        }
+    };
+
+public:
+    TransitionStatistics();
+
+    void add(const Transition &t);
+    /* accumulates the voice-leading data of transition t */
+
+    void merge(const TransitionStatistics &other);
+    /* adds the data accumulated in other to this */
+
+    int total() const;
+    /* returns the number of accumulated transitions */
+
+    int efficient() const;
+    /* returns the number of efficient transitions */
+
+    double efficient_percentage() const;
+    /* returns the percentage of efficient transitions */
+
+    double average_vl_shift() const;
+    /* returns the average voice-leading shift in semitones */
+
+    double average_relative_excess() const;
+    /* returns the average voice-leading excess relative to the efficient voice leading */
+
+    int fixed_common_tones() const;
+    /* returns the number of transitions in which common tones are fixed */
+
+    int contrary_motion() const;
+    /* returns the number of transitions which feature contrary motion */
+
+    int duplicates() const;
+    /* returns the number of congruent duplicates removed by compute */
+
+    const std::map<int,int> &vl_shift_distribution() const;
+    /* returns the distribution of transitions by voice-leading shift */
+
+    const std::map<ipair,int> &mn_type_distribution() const;
+    /* returns the distribution of transitions over mn-types */
+
+    void write_json(std::ostream &os) const;
+    /* writes a snapshot of the accumulated data to os as a JSON object */
+
+    bool read_json(const JsonValue &v);
+    /* replaces the data in this with the snapshot v (as written by write_json), returns false if v is malformed */
+
+    static ivector canonical_key(const Transition &t, bool retrograde = false);
+    /* returns a key which is the same for two transitions iff they are congruent
+     *  - if retrograde = true, transitions congruent to the retrograde of t share its key
+     */
+
+    static int remove_duplicates(std::vector<Transition> &trans, bool retrograde = false);
+    /* removes all but the first member of each congruence class from trans and returns the number of removed items
+     *  - if retrograde = true, a transition is also considered a duplicate of its retrograde
+     */
+
+    static TransitionStatistics compute(const std::vector<Chord> &chords, int k, PreparationScheme p, int z,
+                                        bool aug, bool respell_aug, bool favor_diatonic, int num_threads = 0);
+    /* returns the statistics for transitions of class k between all ordered pairs of distinct chords,
+     * up to congruence (and retrograde if p = NO_PREPARATION)
+     *  - z, aug, respell_aug and favor_diatonic are passed to Transition::elementary_classes and
+     *    Transition::simplify_enharmonic_classes
+     *  - num_threads is the number of worker threads (if 0, use all hardware threads);
+     *    the result does not depend on it
+     */
+};
+
+#endif // TRANSITIONSTATISTICS_H
@@ -0,0 +1,240 @@
+/* transpositioncache.cpp
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "transpositioncache.h"
+#include "profile.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/* Elementary transitions and tonal realizations are defined by conditions on the tones themselves,
+ * so the graph with the extended support contains the shifts of all transitions in cg. A support
+ * which is not an interval of the line of fifths is not extended and the cache is not used. */
+TranspositionCache::TranspositionCache(const ChordGraph &cg, size_t capacity) : _cg(cg) {
+    assert(capacity > 0);
+    _capacity = capacity;
+    const Domain &sup = cg.support();
+    if (sup.ubound() - sup.lbound() + 1 == (int)sup.size()) {
+        std::vector<Chord> chords;
+        for (int i = 1; i <= cg.number_of_vertices(); ++i) {
+            chords.push_back(cg.vertex2chord(i));
+        }
+        Domain ext;
+        ext.insert_range(sup.lbound() - max_shift, sup.ubound() + max_shift);
+        _ext.reset(new ChordGraph(chords, cg.class_index(), ext, cg.preparation_scheme(),
+                                  cg.allows_augmented_sixths(), false, 0));
+    }
+}
+
+const ChordGraph &TranspositionCache::chord_graph() const {
+    return _cg;
+}
+
+size_t TranspositionCache::capacity() const {
+    return _capacity;
+}
+
+size_t TranspositionCache::size() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+void TranspositionCache::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.clear();
+    _lru.clear();
+}
+
+bool TranspositionCache::lookup(const key_type &key, result &res) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::map<key_type,entry>::iterator it = _entries.find(key);
+    if (it == _entries.end())
+        return false;
+    _lru.splice(_lru.begin(), _lru, it->second.pos);
+    res = it->second.res;
+    return true;
+}
+
+void TranspositionCache::store(const key_type &key, const result &res) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::map<key_type,entry>::iterator it = _entries.find(key);
+    if (it != _entries.end()) {
+        if (it->second.res.unique < 0)
+            it->second.res.unique = res.unique;
+        return;
+    }
+    _lru.push_front(key);
+    entry &e = _entries[key];
+    e.res = res;
+    e.pos = _lru.begin();
+    if (_entries.size() > _capacity) {
+        _entries.erase(_lru.back());
+        _lru.pop_back();
+    }
+}
+
+/* Returns the voice-leading terms tcn/4 of the cheapest transitions in g by which v (a voicing of walk) may pass
+ * from a chord to the next one, i.e. those whose second realization is the next realization in v and which glue
+ * to the previous one with a cue iff v has one (then it is their first realization). The terms are stored in vl
+ * (vl[0] is unused). If vl is not empty, then returns true iff a transition whose term is at most vl[l] exists
+ * for each level l, i.e. iff v is a voicing of walk in g whose weight does not exceed the weight of the voicing
+ * for which vl was computed, provided that the first realization of v and its center of gravity z lie in the
+ * support of g (which is also checked). */
+static bool cheapest_transitions(const ChordGraph &g, const ivector &walk, const voicing &v, int z, ivector &vl) {
+    const Domain &sup = g.support();
+    const Realization *pred = NULL, *cue = NULL;
+    bool check = !vl.empty();
+    int l = 0, mc, tcn, min_vl;
+    ivector f;
+    if (z < sup.lbound() || z > sup.ubound() || !sup.contains(v.front().first.tone_set()))
+        return false;
+    if (!check)
+        vl.assign(walk.size(), 0);
+    for (voicing::const_iterator it = v.begin(); it != v.end(); ++it) {
+        if (it->second) {
+            cue = &it->first;
+            continue;
+        }
+        if (pred != NULL) {
+            const std::set<Transition> &trans = g.transitions(walk[l-1], walk[l]);
+            min_vl = RAND_MAX;
+            for (std::set<Transition>::const_iterator jt = trans.begin(); jt != trans.end(); ++jt) {
+                if (jt->second() == it->first && jt->glue(*pred, mc, tcn, f, g.class_index()) &&
+                        (mc > 0) == (cue != NULL) && (cue == NULL || jt->first() == *cue))
+                    min_vl = std::min(min_vl, tcn / 4);
+            }
+            if (check && min_vl > vl[l])
+                return false;
+            vl[l] = min_vl;
+        }
+        pred = &it->first;
+        cue = NULL;
+        ++l;
+    }
+    return true;
+}
+
+/* returns v with all tones shifted by d steps on the line of fifths, respelling the chords as those in the graph
+ * (which matters for diminished seventh chords) */
+static voicing shift(const voicing &v, int d) {
+    voicing ret;
+    for (voicing::const_iterator it = v.begin(); it != v.end(); ++it) {
+        Realization r(it->first);
+        r.transpose(d);
+        Realization s(Chord::from_id(r.chord().id()));
+        for (int i = 0; i < 4; ++i) {
+            s.tone(i) = r.tone(i);
+        }
+        ret.push_back(std::make_pair(s, it->second));
+    }
+    return ret;
+}
+
+/* returns the sum of the distances of the realizations in v (without cues) from z on the line of fifths, which is
+ * the part of the weight of v that depends on its center of gravity z */
+static double spread(const voicing &v, int z) {
+    double ret = 0;
+    for (voicing::const_iterator it = v.begin(); it != v.end(); ++it) {
+        if (!it->second)
+            ret += it->first.lof_point_distance(z);
+    }
+    return ret;
+}
+
+/* The sequence is shifted by d steps on the line of fifths, where -max_shift < d <= max_shift, so that its first
+ * chord has root C, and the optimal voicing v for the shifted sequence is found in the extended graph (it is the
+ * first one in the order in which TransitionNetwork::find_voicing resolves ties). Since the shift of the support
+ * is contained in the extended support, the shift of v by -d is the voicing found in the support if it is
+ * feasible there with the same weight. Otherwise, if all optimal voicings in the extended graph are shifts of v
+ * by multiples of 12, i.e. enharmonically equivalent to v (which is then the flattest of them), the voicing found
+ * in the support is the flattest such shift which is feasible there with the same weight. This holds only if
+ * the center of gravity of v is not tied with a neighboring one, so this is checked as well before any shift of v
+ * is used. With a zero weight ties are common, hence the cache is used only if all weights are positive. */
+bool TranspositionCache::find_voicing(const std::vector<Chord> &seq, int &z0,
+                                      double spread_weight, double vl_weight, double aug_weight, voicing &v) {
+    assert(!seq.empty());
+    ivector walk;
+    for (std::vector<Chord>::const_iterator it = seq.begin(); it != seq.end(); ++it) {
+        int i = _cg.find_vertex_by_chord(*it);
+        if (i == 0 || (it != seq.begin() && _cg.arc(walk.back(), i) == NULL))
+            return false;
+        walk.push_back(i);
+    }
+    std::vector<double> wgh;
+    wgh.push_back(spread_weight);
+    wgh.push_back(vl_weight);
+    wgh.push_back(aug_weight);
+    if (!_ext || spread_weight <= 0 || vl_weight <= 0 || aug_weight <= 0) {
+        z0 = TransitionNetwork::find_voicing(_cg, walk, wgh, v);
+        return true;
+    }
+    int d = Tone::modb(-7 * seq.front().root(), 12), k;
+    if (d > max_shift)
+        d -= 12;
+    key_type key;
+    key.first = wgh;
+    for (std::vector<Chord>::const_iterator it = seq.begin(); it != seq.end(); ++it) {
+        Chord c(*it);
+        c.set_root(c.root() + 7 * d);
+        key.second.push_back(c.id());
+    }
+    ivector cwalk;
+    for (ivector::const_iterator it = key.second.begin(); it != key.second.end(); ++it) {
+        cwalk.push_back(_ext->find_vertex_by_chord(Chord::from_id(*it)));
+    }
+    result res;
+    bool cached = lookup(key, res);
+    if (!cached) {
+        res.z = TransitionNetwork::find_voicing(*_ext, cwalk, wgh, res.v);
+        res.unique = -1;
+        cheapest_transitions(*_ext, cwalk, res.v, res.z, res.vl);
+        store(key, res);
+    }
+    const Domain &sup = _cg.support();
+    for (k = 0; res.z + 12 * k - d <= sup.ubound(); ++k) {
+        if (res.unique < 0) {
+            /* the enumeration of the optimal voicings (up to rounding errors) stops as soon as there are more
+             * of them than the shifts of v which are optimal in the extended graph */
+            unsigned long long shifts = 1, count = 0;
+            double s = spread(res.v, res.z) * (1.0 + 1e-9);
+            for (int j = 1; cheapest_transitions(*_ext, cwalk, shift(res.v, 12 * j), res.z + 12 * j, res.vl); ++j) {
+                ++shifts;
+            }
+            if (spread(res.v, res.z - 1) > s && spread(res.v, res.z + 1) > s) {
+                TransitionNetwork::find_near_optimal_voicings(*_ext, cwalk, wgh, 1e-9, true, [&](double, const voicing &) {
+                    return ++count <= shifts;
+                });
+            }
+            res.unique = count == shifts ? 1 : 0;
+            store(key, res);
+        }
+        if (res.unique == 0)
+            break;
+        v = shift(res.v, 12 * k - d);
+        if (cheapest_transitions(_cg, walk, v, res.z + 12 * k - d, res.vl)) {
+            if (cached)
+                Profile::count(PROFILE_TRANSPOSED_RESULTS_REUSED);
+            z0 = res.z + 12 * k - d;
+            return true;
+        }
+    }
+    v.clear();
+    z0 = TransitionNetwork::find_voicing(_cg, walk, wgh, v);
+    return true;
+}
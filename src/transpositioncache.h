@@ -0,0 +1,92 @@
+/* transpositioncache.h
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRANSPOSITIONCACHE_H
+#define TRANSPOSITIONCACHE_H
+
+#include "transitionnetwork.h"
+#include <list>
+#include <memory>
+#include <mutex>
+
+/* A cache of optimal voicings shared by voicing requests, in which a chord sequence and its transpositions
+ * share one entry. A sequence is transposed so that its first chord has root C, which is a shift of at most six
+ * steps on the line of fifths, and the result for the transposed sequence is shifted back (by a multiple of 12
+ * more, if necessary). Since the support clips the voicings, the transposed sequences are voiced in a chord graph
+ * whose support is extended by six steps on both sides, which contains the shifts of the support. The shifted
+ * result is used only if it is feasible in the support with the same weight and it is certainly the voicing which
+ * ChordGraph::find_voicing would choose, otherwise the sequence is voiced in the support from scratch, which is
+ * also done if some weight is not positive.
+ * The cache holds a bounded number of results, evicting the least recently used, and it may be used from
+ * several threads. */
+class TranspositionCache {
+
+    typedef std::pair<std::vector<double>,ivector> key_type;
+    typedef std::list<key_type> lru_list;
+
+    struct result {
+        int z;
+        voicing v;
+        ivector vl;                         // see cheapest_transitions
+        int unique;                         // 1 iff each optimal voicing is a shift of v by a multiple of 12
+                                            // and z is not tied with z-1 or z+1, -1 if this is not known yet
+    };
+    struct entry {
+        result res;
+        lru_list::iterator pos;
+    };
+
+    const ChordGraph &_cg;
+    std::unique_ptr<ChordGraph> _ext;       // the chord graph with the extended support, if the support is an interval
+    size_t _capacity;
+    mutable std::mutex _mutex;
+    std::map<key_type,entry> _entries;
+    lru_list _lru;                          // the keys, from the most to the least recently used
+
+    bool lookup(const key_type &key, result &res);
+    void store(const key_type &key, const result &res);
+
+public:
+    static const int max_shift = 6;
+
+    TranspositionCache(const ChordGraph &cg, size_t capacity = 4096);
+    /* creates an empty cache for voicing chord sequences in cg, which must outlive this object, holding at most
+     * capacity results (this constructs the chord graph with the extended support) */
+
+    const ChordGraph &chord_graph() const;
+    /* returns the underlying chord graph */
+
+    size_t capacity() const;
+    /* returns the maximal number of cached results */
+
+    size_t size() const;
+    /* returns the number of cached results */
+
+    void clear();
+    /* removes all results from the cache */
+
+    bool find_voicing(const std::vector<Chord> &seq, int &z0,
+                      double spread_weight, double vl_weight, double aug_weight, voicing &v);
+    /* finds an optimal voicing for chord sequence seq, see ChordGraph::find_voicing
+     *  - the result is the same as with ChordGraph::find_voicing
+     */
+};
+
+#endif // TRANSPOSITIONCACHE_H
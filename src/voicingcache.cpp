@@ -0,0 +1,136 @@
+/* voicingcache.cpp
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "voicingcache.h"
+#include "profile.h"
+#include <assert.h>
+
+VoicingCache::VoicingCache(const ChordGraph &cg, size_t capacity) : _cg(cg) {
+    assert(capacity > 0);
+    _capacity = capacity;
+}
+
+const ChordGraph &VoicingCache::chord_graph() const {
+    return _cg;
+}
+
+size_t VoicingCache::capacity() const {
+    return _capacity;
+}
+
+size_t VoicingCache::size() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+void VoicingCache::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.clear();
+    _lru.clear();
+}
+
+/* the key consists of the weights and of z, the chord id and the voices of r, followed by the first len vertices of walk */
+VoicingCache::key_type VoicingCache::make_key(const std::vector<double> &wgh, int z, const Realization &r, const ivector &walk, int len) {
+    key_type key;
+    key.first = wgh;
+    key.second.reserve(6 + len);
+    key.second.push_back(z);
+    key.second.push_back(r.chord().id());
+    for (int i = 0; i < 4; ++i) {
+        key.second.push_back(r.tone(i).lof_position());
+    }
+    key.second.insert(key.second.end(), walk.begin(), walk.begin() + len);
+    return key;
+}
+
+std::shared_ptr<const TransitionNetwork::Frontier> VoicingCache::lookup(const key_type &key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::map<key_type,entry>::iterator it = _entries.find(key);
+    if (it == _entries.end())
+        return std::shared_ptr<const TransitionNetwork::Frontier>();
+    _lru.splice(_lru.begin(), _lru, it->second.pos);
+    return it->second.frontier;
+}
+
+void VoicingCache::store(const key_type &key, const std::shared_ptr<const TransitionNetwork::Frontier> &frontier) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::map<key_type,entry>::iterator it = _entries.find(key);
+    if (it != _entries.end()) {
+        _lru.splice(_lru.begin(), _lru, it->second.pos);
+        return;
+    }
+    _lru.push_front(key);
+    entry &e = _entries[key];
+    e.frontier = frontier;
+    e.pos = _lru.begin();
+    if (_entries.size() > _capacity) {
+        _entries.erase(_lru.back());
+        _lru.pop_back();
+    }
+}
+
+/* The frontiers are computed outside the lock, hence two threads may compute the same frontier,
+ * in which case the one stored first is kept. An evicted frontier stays in memory while a frontier
+ * of a longer prefix which refers to it is cached or in use. */
+double VoicingCache::solve(const ivector &walk, const Realization &r, const std::vector<double> &wgh, int z, voicing &v) {
+    int nl = walk.size() - 1, len;
+    if (nl == 0)
+        return TransitionNetwork::solve(_cg, walk, r, wgh, z, v);
+    std::shared_ptr<const TransitionNetwork::Frontier> fr;
+    for (len = walk.size(); len > 1; --len) {
+        if ((fr = lookup(make_key(wgh, z, r, walk, len))))
+            break;
+    }
+    if (fr)
+        Profile::count(PROFILE_CACHED_LEVELS_REUSED, len - 1);
+    else {
+        fr = TransitionNetwork::first_frontier(_cg, walk, r);
+        len = 2;
+        store(make_key(wgh, z, r, walk, len), fr);
+    }
+    for (; len <= nl; ++len) {
+        fr = TransitionNetwork::next_frontier(_cg, walk, r, wgh, z, fr);
+        store(make_key(wgh, z, r, walk, len + 1), fr);
+    }
+    return TransitionNetwork::finish(_cg, walk, r, wgh, z, *fr, v);
+}
+
+int VoicingCache::find_voicing(const ivector &walk, const std::vector<double> &wgh, voicing &v) {
+    return TransitionNetwork::find_voicing(_cg, walk, wgh, v, [&](const Realization &r, int z, voicing &sv) {
+        return solve(walk, r, wgh, z, sv);
+    });
+}
+
+bool VoicingCache::find_voicing(const std::vector<Chord> &seq, int &z0,
+                                double spread_weight, double vl_weight, double aug_weight, voicing &v) {
+    ivector walk;
+    for (std::vector<Chord>::const_iterator it = seq.begin(); it != seq.end(); ++it) {
+        int i = _cg.find_vertex_by_chord(*it);
+        if (i == 0 || (it != seq.begin() && _cg.arc(walk.back(), i) == NULL))
+            return false;
+        walk.push_back(i);
+    }
+    std::vector<double> wgh;
+    wgh.push_back(spread_weight);
+    wgh.push_back(vl_weight);
+    wgh.push_back(aug_weight);
+    z0 = find_voicing(walk, wgh, v);
+    return true;
+}
@@ -0,0 +1,86 @@
+/* voicingcache.h
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VOICINGCACHE_H
+#define VOICINGCACHE_H
+
+#include "transitionnetwork.h"
+#include <list>
+#include <mutex>
+
+/* A cache of the frontiers of the forward pass in TransitionNetwork::solve, shared by voicing requests.
+ * A frontier is keyed by the weights, the center of gravity, the initial realization and the walk up to its level,
+ * so a request for a walk which extends a previously voiced one resumes from the longest cached prefix and only
+ * processes the remaining levels. The cache holds a bounded number of frontiers, evicting the least recently used,
+ * and it may be used from several threads. */
+class VoicingCache {
+
+    typedef std::pair<std::vector<double>,ivector> key_type;
+    typedef std::list<key_type> lru_list;
+
+    struct entry {
+        std::shared_ptr<const TransitionNetwork::Frontier> frontier;
+        lru_list::iterator pos;
+    };
+
+    const ChordGraph &_cg;
+    size_t _capacity;
+    mutable std::mutex _mutex;
+    std::map<key_type,entry> _entries;
+    lru_list _lru;                          // the keys, from the most to the least recently used
+
+    static key_type make_key(const std::vector<double> &wgh, int z, const Realization &r, const ivector &walk, int len);
+
+    std::shared_ptr<const TransitionNetwork::Frontier> lookup(const key_type &key);
+    void store(const key_type &key, const std::shared_ptr<const TransitionNetwork::Frontier> &frontier);
+
+public:
+    VoicingCache(const ChordGraph &cg, size_t capacity = 4096);
+    /* creates an empty cache for voicing walks in cg, which must outlive this object, holding at most capacity frontiers */
+
+    const ChordGraph &chord_graph() const;
+    /* returns the underlying chord graph */
+
+    size_t capacity() const;
+    /* returns the maximal number of cached frontiers */
+
+    size_t size() const;
+    /* returns the number of cached frontiers */
+
+    void clear();
+    /* removes all frontiers from the cache */
+
+    double solve(const ivector &walk, const Realization &r, const std::vector<double> &wgh, int z, voicing &v);
+    /* finds a cheapest voicing v for walk with initial realization r, center of gravity z and weights wgh
+     * and returns its weight, reusing and caching the frontiers
+     *  - the result is the same as with TransitionNetwork::solve
+     */
+
+    int find_voicing(const ivector &walk, const std::vector<double> &wgh, voicing &v);
+    /* finds an optimal voicing v for walk and returns its gravity center on the line of fifths
+     *  - the result is the same as with TransitionNetwork::find_voicing
+     */
+
+    bool find_voicing(const std::vector<Chord> &seq, int &z0,
+                      double spread_weight, double vl_weight, double aug_weight, voicing &v);
+    /* finds an optimal voicing for chord sequence seq, see ChordGraph::find_voicing */
+};
+
+#endif // VOICINGCACHE_H
@@ -0,0 +1,223 @@
+/* voicingeditor.cpp
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "voicingeditor.h"
+#include "transitionnetwork.h"
+#include "profile.h"
+#include <assert.h>
+#include <float.h>
+
+VoicingEditor::VoicingEditor(const ChordGraph &cg, const std::vector<double> &wgh) :
+    _cg(cg)
+{
+    assert(wgh.size() == 3);
+    _wgh = wgh;
+}
+
+int VoicingEditor::size() const {
+    return _levels.size();
+}
+
+const Chord &VoicingEditor::chord(int i) const {
+    assert(i >= 0 && i < size());
+    return _cg.vertex2chord(_levels[i].chord);
+}
+
+/* sets up the l-th level for its chord and the chord preceding it */
+void VoicingEditor::attach(int l) {
+    const Domain &dom = _cg.support();
+    level &lev = _levels[l];
+    if (l == 0) {
+        _initial = Realization::tonal_realizations(_cg.vertex2chord(lev.chord), dom, _cg.allows_augmented_sixths());
+        lev.glue = NULL;
+    } else lev.glue = &_cg.glue_table(_levels[l-1].chord, lev.chord);
+    lev.msg.resize(dom.ubound() - dom.lbound() + 1);
+}
+
+/* The weights of the arcs from level 0 are those of the arcs from the sources in TransitionNetwork::solve
+ * (see TransitionNetwork::first_arc_weight), i.e. the initial realization is accounted for in level 0.
+ * Ties are resolved as in TransitionNetwork::next_frontier, where the source is the pair (initial realization,
+ * first transition), hence the paths for each initial realization are the same as in TransitionNetwork::solve. */
+void VoicingEditor::compute(int l, int k, message &m) const {
+    int z = _cg.support().lbound() + k, n, np, i, j, p;
+    double c, min_c = DBL_MAX;
+    ipair s;
+    if (l == 0) {
+        n = _initial.size();
+        m.cost.resize(n);
+        m.src.resize(n);
+        m.parent.clear();
+        for (i = 0; i < n; ++i) {
+            m.cost[i] = TransitionNetwork::initial_weight(_initial[i], NULL, 0, _wgh, z);
+            m.src[i] = std::make_pair(i, 0);
+        }
+    } else {
+        const message &prev = _levels[l-1].msg[k];
+        const ChordGraph::GlueTable &gt = *_levels[l].glue;
+        n = gt.size();
+        np = prev.cost.size();
+        m.cost.assign(n, DBL_MAX);
+        m.src.assign(n, std::make_pair(-1, -1));
+        m.parent.assign(n, -1);
+        for (i = 0; i < np; ++i) {
+            /* the tonal realizations of the first chord come first among its predecessors */
+            const ChordGraph::GlueTable::entry *row = gt.row(l == 1 ? i : _levels[l-1].glue->target(i));
+            for (j = 0; j < n; ++j) {
+                c = prev.cost[i] + TransitionNetwork::arc_weight(gt.transition(j), row[j].tcn, _wgh, z);
+                s = l == 1 ? std::make_pair(i, j) : prev.src[i];
+                p = m.parent[j];
+                if (p < 0 || c < m.cost[j] || (c == m.cost[j] && (s < m.src[j] || (s == m.src[j] && prev.cost[i] < prev.cost[p])))) {
+                    m.cost[j] = c;
+                    m.src[j] = s;
+                    m.parent[j] = i;
+                }
+            }
+        }
+    }
+    for (j = 0; j < n; ++j) {
+        min_c = std::min(min_c, m.cost[j]);
+    }
+    for (j = 0; j < n; ++j) {
+        m.cost[j] -= min_c;
+    }
+    m.delta = min_c;
+}
+
+/* The levels first, ..., last are recomputed for each center of gravity, and so are the following ones until
+ * one of them is the same as before, up to the difference to the preceding level. The levels after it are
+ * computed from the same data as before, hence they are unchanged. */
+void VoicingEditor::update(int first, int last) {
+    int n = _levels.size(), nz = _cg.support().ubound() - _cg.support().lbound() + 1, l, k;
+    message m;
+    for (k = 0; k < nz; ++k) {
+        for (l = first; l < n; ++l) {
+            compute(l, k, m);
+            Profile::count(PROFILE_EDITOR_MESSAGES_UPDATED);
+            message &old = _levels[l].msg[k];
+            if (l > last && m.cost == old.cost && m.src == old.src && m.parent == old.parent) {
+                old.delta = m.delta;
+                break;
+            }
+            std::swap(old, m);
+        }
+    }
+}
+
+bool VoicingEditor::assign(const std::vector<Chord> &seq) {
+    ivector walk;
+    for (std::vector<Chord>::const_iterator it = seq.begin(); it != seq.end(); ++it) {
+        int i = _cg.find_vertex_by_chord(*it);
+        if (i == 0 || (it != seq.begin() && _cg.arc(walk.back(), i) == NULL))
+            return false;
+        walk.push_back(i);
+    }
+    _levels.resize(walk.size());
+    for (int l = 0; l < int(walk.size()); ++l) {
+        _levels[l].chord = walk[l];
+        attach(l);
+    }
+    update(0, walk.size() - 1);
+    return true;
+}
+
+/* The arcs entering the i-th and the next level change. */
+bool VoicingEditor::replace(int i, const Chord &c) {
+    int n = size(), v = _cg.find_vertex_by_chord(c);
+    assert(i >= 0 && i < n);
+    if (v == 0 || (i > 0 && _cg.arc(_levels[i-1].chord, v) == NULL) || (i + 1 < n && _cg.arc(v, _levels[i+1].chord) == NULL))
+        return false;
+    _levels[i].chord = v;
+    attach(i);
+    if (i + 1 < n)
+        attach(i + 1);
+    update(i, i + 1);
+    return true;
+}
+
+/* The i-th level is new and the arcs entering the next level change. */
+bool VoicingEditor::insert(int i, const Chord &c) {
+    int n = size(), v = _cg.find_vertex_by_chord(c);
+    assert(i >= 0 && i <= n);
+    if (v == 0 || (i > 0 && _cg.arc(_levels[i-1].chord, v) == NULL) || (i < n && _cg.arc(v, _levels[i].chord) == NULL))
+        return false;
+    level lev;
+    lev.chord = v;
+    lev.glue = NULL;
+    _levels.insert(_levels.begin() + i, lev);
+    attach(i);
+    if (i < n)
+        attach(i + 1);
+    update(i, i + 1);
+    return true;
+}
+
+/* Only the arcs entering the level which takes the place of the i-th one change
+ * (if it is the first level, its vertices change). */
+bool VoicingEditor::erase(int i) {
+    int n = size();
+    assert(i >= 0 && i < n);
+    if (i > 0 && i + 1 < n && _cg.arc(_levels[i-1].chord, _levels[i+1].chord) == NULL)
+        return false;
+    _levels.erase(_levels.begin() + i);
+    if (i + 1 < n) {
+        attach(i);
+        update(i, i);
+    }
+    return true;
+}
+
+/* The weight of the cheapest path for a center of gravity is the sum of the differences between the levels.
+ * The sink is chosen as in TransitionNetwork::finish, and the ties between the centers of gravity are resolved
+ * as in TransitionNetwork::find_voicing. */
+int VoicingEditor::find_voicing(voicing &v) const {
+    assert(!_levels.empty());
+    int n = _levels.size(), nz = _cg.support().ubound() - _cg.support().lbound() + 1, l, k, j, b, best_k = -1, best_j = 0;
+    double w, min_w = 0;
+    for (k = 0; k < nz; ++k) {
+        const message &last = _levels.back().msg[k];
+        for (w = 0, l = 0; l < n; ++l) {
+            w += _levels[l].msg[k].delta;
+        }
+        for (b = 0, j = 1; j < int(last.cost.size()); ++j) {
+            if (last.cost[j] < last.cost[b] || (last.cost[j] == last.cost[b] && last.src[j] < last.src[b]))
+                b = j;
+        }
+        if (best_k < 0 || w < min_w || (w == min_w && last.src[b].first < _levels.back().msg[best_k].src[best_j].first)) {
+            min_w = w;
+            best_k = k;
+            best_j = b;
+        }
+    }
+    std::vector<const ChordGraph::GlueTable*> gt(n);
+    ivector path(n);
+    for (j = best_j, l = n - 1; l > 0; --l) {
+        path[l] = j;
+        gt[l] = _levels[l].glue;
+        j = _levels[l].msg[best_k].parent[j];
+    }
+    if (n > 1)
+        TransitionNetwork::realize(_cg, gt, _initial[j], path, v);
+    else {
+        v.clear();
+        v.push_back(std::make_pair(_initial[j], false));
+    }
+    TransitionNetwork::arrange_voices(v);
+    return _cg.support().lbound() + best_k;
+}
@@ -0,0 +1,88 @@
+/* voicingeditor.h
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VOICINGEDITOR_H
+#define VOICINGEDITOR_H
+
+#include "chordgraph.h"
+
+/* A chord sequence which is kept voiced while it is being edited. For each center of gravity, the forward pass
+ * of TransitionNetwork::solve is stored level by level, with the initial realizations forming level 0, so that
+ * the paths for all initial realizations are processed at once. The weights in a level are stored relative to
+ * the cheapest one, hence a level does not depend on the chords before an edited one as soon as its relative
+ * weights, sources and parents are the same as before the edit. After replacing, inserting or erasing a chord,
+ * the levels are recomputed from the affected ones until this happens, which usually takes a few levels. */
+class VoicingEditor {
+
+    struct message {
+        double delta;                       // the weight of the cheapest path to the level minus that to the preceding one
+        std::vector<double> cost;           // the weight of the cheapest path to each vertex, minus that of the cheapest one
+        std::vector<ipair> src;             // the initial realization and the first transition on that path
+        ivector parent;                     // its vertex in the preceding level (empty in level 0)
+    };
+
+    struct level {
+        int chord;                          // vertex in the chord graph
+        const ChordGraph::GlueTable *glue;  // the glue table of the arc entering the level (NULL in level 0)
+        std::vector<message> msg;           // indexed by the center of gravity
+    };
+
+    const ChordGraph &_cg;
+    std::vector<double> _wgh;
+    std::vector<Realization> _initial;      // the tonal realizations of the first chord
+    std::vector<level> _levels;
+
+    void compute(int l, int z, message &m) const;
+    void update(int first, int last);
+    void attach(int l);
+
+public:
+    VoicingEditor(const ChordGraph &cg, const std::vector<double> &wgh);
+    /* creates an empty sequence which will be voiced in cg, which must outlive this object, with weights wgh */
+
+    bool assign(const std::vector<Chord> &seq);
+    /* replaces the sequence with seq, returns false (leaving the sequence unchanged) if seq is not a walk in the chord graph */
+
+    bool replace(int i, const Chord &c);
+    /* replaces the i-th chord with c, returns false (leaving the sequence unchanged) if the result is not a walk */
+
+    bool insert(int i, const Chord &c);
+    /* inserts c before the i-th chord (or appends it if i is the size of the sequence),
+     * returns false (leaving the sequence unchanged) if the result is not a walk */
+
+    bool erase(int i);
+    /* removes the i-th chord, returns false (leaving the sequence unchanged) if the result is not a walk */
+
+    int size() const;
+    /* returns the number of chords in the sequence */
+
+    const Chord &chord(int i) const;
+    /* returns the i-th chord */
+
+    int find_voicing(voicing &v) const;
+    /* finds an optimal voicing v for the sequence, which must not be empty, and returns its gravity center
+     * on the line of fifths
+     *  - the weight of v is the same as with TransitionNetwork::find_voicing, which also resolves ties
+     *    in the same way, up to rounding errors
+     *  - the result depends only on the sequence and not on the edits by which it was obtained
+     */
+};
+
+#endif // VOICINGEDITOR_H
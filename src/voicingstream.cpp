@@ -0,0 +1,302 @@
+/* voicingstream.cpp
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "voicingstream.h"
+#include "transitionnetwork.h"
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+VoicingStream::VoicingStream(const ChordGraph &cg, const std::vector<double> &wgh, int lag) :
+    _cg(cg)
+{
+    assert(wgh.size() == 3 && lag >= 0);
+    _wgh = wgh;
+    _lag = lag;
+    _size = _committed = _z = 0;
+}
+
+int VoicingStream::lag() const {
+    return _lag;
+}
+
+int VoicingStream::size() const {
+    return _size;
+}
+
+int VoicingStream::committed() const {
+    return _committed;
+}
+
+int VoicingStream::tonal_center() const {
+    return _z;
+}
+
+const Realization &VoicingStream::initial_realization(int hyp) const {
+    return _initial[_hyp[hyp].first];
+}
+
+/* The first level carries no weight until the second level is attached (see TransitionNetwork::first_arc_weight),
+ * hence the cost of a path ending there is computed separately. */
+double VoicingStream::final_cost(const level &lev, const node &nd) const {
+    if (lev.index > 1)
+        return nd.cost;
+    const Realization &X0 = initial_realization(nd.hyp);
+    return TransitionNetwork::initial_weight(X0, lev.index == 1 ? lev.trans[nd.t] : NULL, nd.tcn, _wgh, _hyp[nd.hyp].second);
+}
+
+int VoicingStream::best_node() const {
+    const level &lev = _levels.back();
+    int best = -1;
+    double c, min_c = DBL_MAX;
+    for (int i = 0; i < int(lev.nodes.size()); ++i) {
+        if (lev.nodes[i].cost == DBL_MAX)
+            continue;
+        c = final_cost(lev, lev.nodes[i]);
+        /* a path and its transposition by an octave on the line of fifths may have the same cost
+         * for different gravity centers, prefer the one which is closer to D in that case */
+        if (best < 0 || c < min_c ||
+                (c == min_c && abs(_hyp[lev.nodes[i].hyp].second) < abs(_hyp[lev.nodes[best].hyp].second))) {
+            best = i;
+            min_c = c;
+        }
+    }
+    assert(best >= 0);
+    return best;
+}
+
+int VoicingStream::ancestor(int i, int index) const {
+    for (int p = _levels.size() - 1; _levels[p].index > index; --p) {
+        i = _levels[p].nodes[i].parent;
+    }
+    return i;
+}
+
+void VoicingStream::realize_node(const level &lev, const node &nd, voicing &out) const {
+    if (lev.index == 0) {
+        out.push_back(std::make_pair(_initial[nd.t], false));
+        return;
+    }
+    ivector f(Transition::sym4[nd.perm], Transition::sym4[nd.perm] + 4);
+    const Transition &t = *lev.trans[nd.t];
+    if (nd.cue) {
+        Realization r = t.first();
+        r.arrange(f);
+        out.push_back(std::make_pair(r, true));
+    }
+    Realization r = t.second();
+    r.arrange(f);
+    out.push_back(std::make_pair(r, false));
+}
+
+/* The tonal realizations of the first chord come first among its predecessors (see ChordGraph::predecessors),
+ * hence the glue table row of an initial realization is given by its index. */
+void VoicingStream::relax(const level &prev, int s, level &lev, int base) const {
+    int w0 = prev.width(), w = lev.width(), h = prev.hyps[s], z = _hyp[h].second, i, j, k;
+    const ChordGraph::GlueTable &gt = *lev.glue;
+    ivector f(4);
+    double c;
+    for (i = 0; i < w0; ++i) {
+        const node &u = prev.nodes[s * w0 + i];
+        if (u.cost == DBL_MAX)
+            continue;
+        const ChordGraph::GlueTable::entry *row = gt.row(prev.index == 0 ? u.t : prev.glue->target(u.t));
+        for (j = 0; j < w; ++j) {
+            if (prev.index == 0)
+                c = 0;
+            else if (prev.index == 1)
+                c = u.cost + TransitionNetwork::first_arc_weight(initial_realization(h), *prev.trans[u.t], u.tcn,
+                                                                 *lev.trans[j], row[j].tcn, _wgh, z);
+            else c = u.cost + TransitionNetwork::arc_weight(*lev.trans[j], row[j].tcn, _wgh, z);
+            node &nd = lev.nodes[base + j];
+            if (c < nd.cost) {
+                nd.cost = c;
+                nd.parent = s * w0 + i;
+                nd.tcn = row[j].tcn;
+            }
+        }
+    }
+    /* compose the voice mappings along the chosen arcs */
+    for (j = 0; j < w; ++j) {
+        node &nd = lev.nodes[base + j];
+        if (nd.parent < 0)
+            continue;
+        const node &u = prev.nodes[nd.parent];
+        const ChordGraph::GlueTable::entry &e = gt.row(prev.index == 0 ? u.t : prev.glue->target(u.t))[j];
+        const int *fp = Transition::sym4[u.perm], *phi = Transition::sym4[e.phi];
+        for (k = 0; k < 4; ++k) {
+            f[k] = phi[fp[k]];
+        }
+        nd.perm = Transition::sym4_index(f);
+        nd.cue = e.mc > 0;
+    }
+}
+
+void VoicingStream::extend(int chord) {
+    const level &prev = _levels.back();
+    level lev;
+    int i, j, s, base;
+    lev.index = prev.index + 1;
+    lev.chord = chord;
+    lev.glue = &_cg.glue_table(prev.chord, chord);
+    for (i = 0; i < lev.glue->size(); ++i) {
+        lev.trans.push_back(&lev.glue->transition(i));
+    }
+    int w0 = prev.width(), w = lev.width();
+    /* relax the arcs separately for each surviving pair (X0,z) */
+    for (s = 0; s < int(prev.hyps.size()); ++s) {
+        for (i = 0; i < w0 && prev.nodes[s * w0 + i].cost == DBL_MAX; ++i);
+        if (i == w0)
+            continue;
+        base = lev.nodes.size();
+        lev.hyps.push_back(prev.hyps[s]);
+        for (j = 0; j < w; ++j) {
+            node nd;
+            nd.t = j;
+            nd.hyp = prev.hyps[s];
+            nd.parent = -1;
+            nd.tcn = 0;
+            nd.cost = DBL_MAX;
+            nd.perm = 0;
+            nd.cue = false;
+            lev.nodes.push_back(nd);
+        }
+        relax(prev, s, lev, base);
+    }
+    _levels.push_back(lev);
+}
+
+void VoicingStream::commit(int i, voicing &out) {
+    int pos = _committed - _levels.front().index, k = ancestor(i, _committed), p, n;
+    level &lev = _levels[pos];
+    if (_committed == 0) {
+        /* fix the gravity center and choose the voice arrangement by looking at the current optimal path */
+        _z = _hyp[lev.nodes[k].hyp].second;
+        std::vector<int> path(_levels.size());
+        for (p = _levels.size(); p-->0;) {
+            path[p] = i;
+            i = _levels[p].nodes[i].parent;
+        }
+        voicing v;
+        for (p = 0; p < int(_levels.size()); ++p) {
+            realize_node(_levels[p], _levels[p].nodes[path[p]], v);
+        }
+        TransitionNetwork::arrange_voices(v);
+        const Realization &X0 = _initial[lev.nodes[k].t];
+        _arrangement.resize(4);
+        for (p = 0; p < 4; ++p) {
+            for (n = 0; n < 4 && X0.tone(n) != v.front().first.tone(p); ++n);
+            assert(n < 4);
+            _arrangement[p] = n;
+        }
+    }
+    int start = out.size();
+    realize_node(lev, lev.nodes[k], out);
+    for (voicing::iterator it = out.begin() + start; it != out.end(); ++it) {
+        it->first.arrange(_arrangement);
+    }
+    /* keep only the paths through the committed node; a node in a later level whose best parent is pruned
+     * may still be reached through another one, hence the arcs from the pair (X0,z) of the committed node
+     * are relaxed again in the following levels */
+    int h = lev.nodes[k].hyp, s, t;
+    for (n = 0; n < int(lev.nodes.size()); ++n) {
+        if (n != k)
+            lev.nodes[n].cost = DBL_MAX;
+    }
+    for (p = pos + 1; p < int(_levels.size()); ++p) {
+        const level &prev = _levels[p-1];
+        level &cur = _levels[p];
+        for (n = 0; n < int(cur.nodes.size()); ++n) {
+            cur.nodes[n].cost = DBL_MAX;
+            cur.nodes[n].parent = -1;
+        }
+        for (s = 0; s < int(prev.hyps.size()) && prev.hyps[s] != h; ++s);
+        for (t = 0; t < int(cur.hyps.size()) && cur.hyps[t] != h; ++t);
+        if (s < int(prev.hyps.size()) && t < int(cur.hyps.size()))
+            relax(prev, s, cur, t * cur.width());
+    }
+    ++_committed;
+    while (_levels.size() > 1 && _levels.front().index < _committed) {
+        _levels.pop_front();
+    }
+}
+
+bool VoicingStream::push(const Chord &c, voicing &out) {
+    int v = _cg.find_vertex_by_chord(c), i, a;
+    if (v == 0)
+        return false;
+    if (_size == 0) {
+        const Domain &dom = _cg.support();
+        _initial = Realization::tonal_realizations(c, dom, _cg.allows_augmented_sixths());
+        level lev;
+        lev.index = 0;
+        lev.chord = v;
+        lev.glue = NULL;
+        for (i = 0; i < int(_initial.size()); ++i) {
+            for (int z = dom.lbound(); z <= dom.ubound(); ++z) {
+                node nd;
+                nd.t = i;
+                nd.hyp = _hyp.size();
+                nd.parent = -1;
+                nd.tcn = 0;
+                nd.cost = 0;
+                nd.perm = 0;
+                nd.cue = false;
+                lev.hyps.push_back(nd.hyp);
+                lev.nodes.push_back(nd);
+                _hyp.push_back(std::make_pair(i, z));
+            }
+        }
+        _levels.push_back(lev);
+    } else {
+        if (_cg.arc(_levels.back().chord, v) == NULL)
+            return false;
+        extend(v);
+    }
+    ++_size;
+    /* commit the chords which are too far behind */
+    while (_committed < _size - _lag) {
+        commit(best_node(), out);
+    }
+    /* commit the chords which are ancestors of all surviving paths */
+    while (_committed < _size) {
+        const std::vector<node> &nodes = _levels.back().nodes;
+        a = -1;
+        for (i = 0; i < int(nodes.size()); ++i) {
+            if (nodes[i].cost == DBL_MAX)
+                continue;
+            if (a < 0)
+                a = ancestor(i, _committed);
+            else if (ancestor(i, _committed) != a)
+                break;
+        }
+        if (i < int(nodes.size()))
+            break;
+        commit(best_node(), out);
+    }
+    return true;
+}
+
+void VoicingStream::flush(voicing &out) {
+    while (_committed < _size) {
+        commit(best_node(), out);
+    }
+}
@@ -0,0 +1,98 @@
+/* voicingstream.h
+ *
+ * Copyright (c) 2020  Luka Marohnić
+ *
+ * This file is part of Septima.
+ *
+ * Septima is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Septima is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Septima.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VOICINGSTREAM_H
+#define VOICINGSTREAM_H
+
+#include "chordgraph.h"
+#include <deque>
+
+class VoicingStream {
+
+    struct node {
+        int t;              // index of the transition in its level (index of X0 at level 0)
+        int hyp;            // index of the pair (X0,z)
+        int parent;         // index of the parent node in the preceding level
+        int tcn;            // taxicab norm of voice leading from the parent realization
+        double cost;        // weight of the cheapest path to this node, DBL_MAX if the node is pruned
+        unsigned char perm; // voice mapping from X0, given as an index in Transition::sym4
+        bool cue;
+    };
+
+    struct level {
+        int index;          // position of the chord in the stream
+        int chord;          // vertex in the chord graph
+        ivector hyps;       // surviving pairs (X0,z), nodes are grouped by them
+        std::vector<const Transition*> trans;
+        const ChordGraph::GlueTable *glue; // the glue table of the arc entering this level (NULL for the first)
+        std::vector<node> nodes;
+        int width() const { return index == 0 ? 1 : trans.size(); }
+    };
+
+    const ChordGraph &_cg;
+    std::vector<double> _wgh;
+    int _lag;
+    int _size;
+    int _committed;
+    int _z;
+    ivector _arrangement;
+    std::vector<Realization> _initial;
+    std::vector<ipair> _hyp;
+    std::deque<level> _levels;
+
+    const Realization &initial_realization(int hyp) const;
+    double final_cost(const level &lev, const node &nd) const;
+    int best_node() const;
+    int ancestor(int i, int index) const;
+    void realize_node(const level &lev, const node &nd, voicing &out) const;
+    void relax(const level &prev, int s, level &lev, int base) const;
+    void extend(int chord);
+    void commit(int k, voicing &out);
+
+public:
+    VoicingStream(const ChordGraph &cg, const std::vector<double> &wgh, int lag);
+    /* creates an empty stream of chords which will be voiced in cg with weights wgh
+     *  - lag is the number of chords which are received before a realization is committed
+     */
+
+    bool push(const Chord &c, voicing &out);
+    /* appends c to the stream and appends newly committed realizations (cues included) to out
+     *  - returns false if c is not a vertex in the chord graph or if it does not follow the preceding chord
+     *  - the realization of a chord is committed as soon as it cannot change anymore,
+     *    but no later than after receiving further lag chords
+     */
+
+    void flush(voicing &out);
+    /* commits the optimal realizations of all remaining chords and appends them to out */
+
+    int lag() const;
+    /* returns the lag */
+
+    int size() const;
+    /* returns the number of received chords */
+
+    int committed() const;
+    /* returns the number of chords whose realizations are committed */
+
+    int tonal_center() const;
+    /* returns the gravity center on the line of fifths, which is fixed by the first commit */
+};
+
+#endif // VOICINGSTREAM_H